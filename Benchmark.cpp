@@ -0,0 +1,481 @@
+/************************************************************************
+     File:        Benchmark.cpp
+
+     Comment:
+						Scripted benchmark runs. See Benchmark.H for the
+						overview and the command line.
+
+						The percentiles are nearest rank over the measured
+						frames of a mode. The JSON is written by hand in a
+						fixed layout, with every string escaped, and the
+						baseline is read back by looking for the keys of
+						that layout, so only files written by this class
+						can be compared.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "Benchmark.H"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+static const char* MODE_NAMES[] = { "", "sine", "heightmap", "ripple", "ocean" };
+// in the order of WaterFrameBuffers::UpdatePolicy
+static const char* UPDATE_POLICY_NAMES[] = { "every", "move", "nth", "rows" };
+static const int UPDATE_POLICIES = sizeof(UPDATE_POLICY_NAMES) / sizeof(UPDATE_POLICY_NAMES[0]);
+
+//************************************************************************
+//
+// * Milliseconds on the steady clock
+//========================================================================
+static double nowMs()
+//========================================================================
+{
+	return std::chrono::duration<double, std::milli>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//************************************************************************
+//
+// * Nearest rank percentile of sorted values, p in [0, 100]
+//========================================================================
+static double percentile(const std::vector<double>& sorted, double p)
+//========================================================================
+{
+	if (sorted.empty())
+		return 0.0;
+	size_t rank = (size_t)(p / 100.0 * sorted.size() + 0.999999);
+	return sorted[std::min(std::max(rank, (size_t)1), sorted.size()) - 1];
+}
+
+//************************************************************************
+//
+// * {"mean": .., "p50": .., "p95": .., "p99": .., "min": .., "max": ..}
+//========================================================================
+static std::string statistics(const std::vector<double>& values)
+//========================================================================
+{
+	std::vector<double> sorted(values);
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < sorted.size(); ++i)
+		sum += sorted[i];
+
+	char text[256];
+	snprintf(text, sizeof(text),
+			 "{\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"min\": %.4f, \"max\": %.4f}",
+			 sorted.empty() ? 0.0 : sum / sorted.size(),
+			 percentile(sorted, 50), percentile(sorted, 95), percentile(sorted, 99),
+			 sorted.empty() ? 0.0 : sorted.front(), sorted.empty() ? 0.0 : sorted.back());
+	return text;
+}
+
+//************************************************************************
+//
+// * text as the inside of a JSON string: quotes and backslashes escaped,
+//   control characters dropped, as TraceRecorder writes names
+//========================================================================
+static std::string escaped(const std::string& text)
+//========================================================================
+{
+	std::string out;
+	for (size_t i = 0; i < text.size(); ++i) {
+		if (text[i] == '"' || text[i] == '\\')
+			out += '\\';
+		if ((unsigned char)text[i] >= 0x20)
+			out += text[i];
+	}
+	return out;
+}
+
+//************************************************************************
+//
+// * The number after "key": at or past from, npos if there is none
+//========================================================================
+static size_t findNumber(const std::string& text, const char* key, size_t from, double& value)
+//========================================================================
+{
+	std::string quoted = std::string("\"") + key + "\":";
+	size_t at = text.find(quoted, from);
+	if (at == std::string::npos)
+		return at;
+	value = atof(text.c_str() + at + quoted.size());
+	return at + quoted.size();
+}
+
+//************************************************************************
+//
+// * Read the options listed in Benchmark.H
+//========================================================================
+bool BenchmarkSettings::
+parse(int argc, char** argv)
+//========================================================================
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		const char* value = argv[++i];
+
+		if (!strcmp(arg, "--benchmark"))
+			output = value;
+		else if (!strcmp(arg, "--camera-path"))
+			cameraPath = value;
+		else if (!strcmp(arg, "--drops"))
+			dropSchedule = value;
+		else if (!strcmp(arg, "--baseline"))
+			baseline = value;
+		else if (!strcmp(arg, "--record-camera"))
+			recordCamera = value;
+		else if (!strcmp(arg, "--threshold"))
+			threshold = atof(value);
+		else if (!strcmp(arg, "--frames"))
+			frames = atoi(value);
+		else if (!strcmp(arg, "--warmup"))
+			warmupFrames = atoi(value);
+		else if (!strcmp(arg, "--modes"))
+			modes = value;
+		else if (!strcmp(arg, "--trace"))
+			trace = value;
+		else if (!strcmp(arg, "--trace-start"))
+			traceStart = atoi(value);
+		else if (!strcmp(arg, "--trace-frames"))
+			traceFrames = atoi(value);
+		else if (!strcmp(arg, "--update-policy")) {
+			updatePolicy = -1;
+			for (int p = 0; p < UPDATE_POLICIES; ++p)
+				if (!strcmp(value, UPDATE_POLICY_NAMES[p]))
+					updatePolicy = p;
+		}
+		else if (!strcmp(arg, "--update-interval"))
+			updateInterval = atoi(value);
+		else if (!strcmp(arg, "--move-threshold"))
+			moveThreshold = (float)atof(value);
+		else if (!strcmp(arg, "--turn-threshold"))
+			turnThreshold = (float)atof(value);
+		else
+			return false;
+	}
+
+	if (frames <= 0 || warmupFrames < 0 || modes.empty() || traceStart < 0 || traceFrames <= 0)
+		return false;
+	if (updatePolicy < 0 || updateInterval < 1 || moveThreshold < 0.0f || turnThreshold < 0.0f)
+		return false;
+	for (size_t i = 0; i < modes.size(); ++i)
+		if (modes[i] < '1' || modes[i] > '4')
+			return false;
+	return true;
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+const char* BenchmarkSettings::
+updatePolicyName(int policy)
+//========================================================================
+{
+	return policy >= 0 && policy < UPDATE_POLICIES ? UPDATE_POLICY_NAMES[policy] : "unknown";
+}
+
+//************************************************************************
+//
+// * Nothing runs before load()
+//========================================================================
+Benchmark::
+Benchmark(const BenchmarkSettings& settings)
+//========================================================================
+	: settings(settings), modeIndex(0), frame(-settings.warmupFrames - 1), lastDraw(0.0)
+{
+}
+
+//************************************************************************
+//
+// * Camera path and drop schedule, from the files or built in
+//========================================================================
+bool Benchmark::
+load(const ArcBallCam::Pose& start)
+//========================================================================
+{
+	if (settings.cameraPath.empty())
+		path = CameraPath::orbit(start, warmupFrames() + settings.frames);
+	else if (!path.load(settings.cameraPath.c_str())) {
+		std::cout << "ERROR::BENCHMARK::CANNOT_READ " << settings.cameraPath << std::endl;
+		return false;
+	}
+
+	drops.clear();
+	if (settings.dropSchedule.empty()) {
+		// a drop every 20 frames, placed by a fixed LCG so every run and
+		// every platform gets the same ones
+		unsigned int seed = 12345;
+		for (int f = 0; f < settings.frames; f += 20) {
+			ScheduledDrop drop;
+			drop.frame = f;
+			seed = seed * 1664525u + 1013904223u;
+			drop.u = 0.1f + 0.8f * (seed >> 8) / 16777216.0f;
+			seed = seed * 1664525u + 1013904223u;
+			drop.v = 0.1f + 0.8f * (seed >> 8) / 16777216.0f;
+			drop.radius = 1.0f + (f / 20) % 3;
+			drop.keepTime = 2.0f;
+			drops.push_back(drop);
+		}
+		return true;
+	}
+
+	std::ifstream file(settings.dropSchedule.c_str());
+	if (!file) {
+		std::cout << "ERROR::BENCHMARK::CANNOT_READ " << settings.dropSchedule << std::endl;
+		return false;
+	}
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		ScheduledDrop drop;
+		if (fields >> drop.frame >> drop.u >> drop.v >> drop.radius >> drop.keepTime)
+			drops.push_back(drop);
+		else
+			std::cout << "ERROR::BENCHMARK::BAD_DROP_LINE " << line << std::endl;
+	}
+	return true;
+}
+
+//************************************************************************
+//
+// * Next frame, next mode after the last measured frame
+//========================================================================
+bool Benchmark::
+advance()
+//========================================================================
+{
+	if (modeIndex >= settings.modes.size())
+		return false;
+
+	if (++frame >= settings.frames) {
+		if (++modeIndex >= settings.modes.size())
+			return false;
+		frame = -warmupFrames();
+	}
+
+	if (modeStarted()) {
+		ModeResult result;
+		result.mode = mode();
+		results.push_back(result);
+		std::cout << "BENCHMARK mode " << mode() << " (" << MODE_NAMES[mode()] << ")" << std::endl;
+	}
+	return true;
+}
+
+//************************************************************************
+//
+// * Every mode replays the path from its start
+//========================================================================
+const ArcBallCam::Pose& Benchmark::
+pose() const
+//========================================================================
+{
+	return path.at((size_t)(frame + warmupFrames()));
+}
+
+//************************************************************************
+//
+// * The drops scheduled on the current frame
+//========================================================================
+void Benchmark::
+dropsThisFrame(std::vector<ScheduledDrop>& out) const
+//========================================================================
+{
+	out.clear();
+	for (size_t i = 0; i < drops.size(); ++i)
+		if (drops[i].frame == frame)
+			out.push_back(drops[i]);
+}
+
+//************************************************************************
+//
+// * The simulation step is timed like a pass, it has no GPU part
+//========================================================================
+void Benchmark::
+simulated(double ms)
+//========================================================================
+{
+	if (!measuring())
+		return;
+	pass("simulate").cpu.values.push_back(ms);
+}
+
+//************************************************************************
+//
+// * Frame time since the last draw, plus the latest pass timings and
+//   the scale of the water targets
+//========================================================================
+void Benchmark::
+drawn(const std::vector<PassTimer::Timing>& passes, double gpuFrameMs, double waterScale)
+//========================================================================
+{
+	double now = nowMs();
+	double frameMs = now - lastDraw;
+	lastDraw = now;
+
+	// the first measured frame still needs the draw before it
+	if (!measuring() || frame == 0 || results.empty())
+		return;
+
+	ModeResult& result = results.back();
+	result.frame.values.push_back(frameMs);
+	if (gpuFrameMs > 0.0)
+		result.gpuFrame.values.push_back(gpuFrameMs);
+	result.waterScale.values.push_back(waterScale);
+	for (size_t i = 0; i < passes.size(); ++i) {
+		PassSamples& samples = pass(passes[i].name);
+		samples.cpu.values.push_back(passes[i].cpuMs);
+		samples.gpu.values.push_back(passes[i].gpuMs);
+	}
+}
+
+//************************************************************************
+//
+// * Samples of a pass of the current mode, added on first use
+//========================================================================
+Benchmark::PassSamples& Benchmark::
+pass(const std::string& name)
+//========================================================================
+{
+	std::vector<PassSamples>& passes = results.back().passes;
+	for (size_t i = 0; i < passes.size(); ++i)
+		if (passes[i].name == name)
+			return passes[i];
+	passes.push_back(PassSamples());
+	passes.back().name = name;
+	return passes.back();
+}
+
+//************************************************************************
+//
+// * Mean and p95 frame time of every mode against the baseline's
+//========================================================================
+bool Benchmark::
+compare(std::vector<std::string>& failures) const
+//========================================================================
+{
+	std::ifstream file(settings.baseline.c_str());
+	if (!file) {
+		failures.push_back("cannot read baseline " + settings.baseline);
+		return false;
+	}
+	std::stringstream buffer;
+	buffer << file.rdbuf();
+	std::string text = buffer.str();
+
+	for (size_t r = 0; r < results.size(); ++r) {
+		const ModeResult& result = results[r];
+
+		// find this mode's frame_ms block in the baseline
+		size_t at = 0;
+		double baseMean = 0.0, baseP95 = 0.0, mode = 0.0;
+		while ((at = findNumber(text, "mode", at, mode)) != std::string::npos && (int)mode != result.mode)
+			;
+		if (at == std::string::npos || (at = text.find("\"frame_ms\"", at)) == std::string::npos) {
+			std::cout << "BENCHMARK mode " << result.mode << " not in the baseline" << std::endl;
+			continue;
+		}
+		findNumber(text, "mean", at, baseMean);
+		findNumber(text, "p95", at, baseP95);
+
+		std::vector<double> sorted(result.frame.values);
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0.0;
+		for (size_t i = 0; i < sorted.size(); ++i)
+			sum += sorted[i];
+		double mean = sorted.empty() ? 0.0 : sum / sorted.size();
+		double p95 = percentile(sorted, 95);
+
+		const char* names[] = { "mean", "p95" };
+		double now[] = { mean, p95 };
+		double base[] = { baseMean, baseP95 };
+		for (int i = 0; i < 2; ++i) {
+			double change = base[i] > 0.0 ? now[i] / base[i] - 1.0 : 0.0;
+			char line[256];
+			snprintf(line, sizeof(line), "mode %d %s %.3f ms, baseline %.3f ms (%+.1f%%)",
+					 result.mode, names[i], now[i], base[i], change * 100.0);
+			std::cout << "BENCHMARK " << line << std::endl;
+			if (change > settings.threshold)
+				failures.push_back(line);
+		}
+	}
+	return failures.empty();
+}
+
+//************************************************************************
+//
+// * Results JSON, then the baseline check
+//========================================================================
+bool Benchmark::
+finish(const std::string& renderer, int width, int height)
+//========================================================================
+{
+	std::vector<std::string> failures;
+	bool passed = settings.baseline.empty() || compare(failures);
+
+	std::ofstream out(settings.output.c_str());
+	if (!out) {
+		std::cout << "ERROR::BENCHMARK::CANNOT_WRITE " << settings.output << std::endl;
+		return false;
+	}
+
+	out << "{\n";
+	out << "  \"version\": 1,\n";
+	out << "  \"renderer\": \"" << escaped(renderer) << "\",\n";
+	out << "  \"width\": " << width << ",\n";
+	out << "  \"height\": " << height << ",\n";
+	out << "  \"frames\": " << settings.frames << ",\n";
+	out << "  \"warmup_frames\": " << settings.warmupFrames << ",\n";
+	out << "  \"camera_path\": \"" << (settings.cameraPath.empty() ? "orbit" : escaped(settings.cameraPath)) << "\",\n";
+	out << "  \"drop_schedule\": \"" << (settings.dropSchedule.empty() ? "builtin" : escaped(settings.dropSchedule)) << "\",\n";
+	out << "  \"update_policy\": \"" << BenchmarkSettings::updatePolicyName(settings.updatePolicy) << "\",\n";
+	out << "  \"update_interval\": " << settings.updateInterval << ",\n";
+	out << "  \"modes\": [\n";
+	for (size_t r = 0; r < results.size(); ++r) {
+		const ModeResult& result = results[r];
+		out << "    {\n";
+		out << "      \"mode\": " << result.mode << ",\n";
+		out << "      \"name\": \"" << MODE_NAMES[result.mode] << "\",\n";
+		out << "      \"frame_ms\": " << statistics(result.frame.values) << ",\n";
+		out << "      \"gpu_frame_ms\": " << statistics(result.gpuFrame.values) << ",\n";
+		out << "      \"water_scale\": " << statistics(result.waterScale.values) << ",\n";
+		out << "      \"passes\": [\n";
+		for (size_t p = 0; p < result.passes.size(); ++p) {
+			const PassSamples& pass = result.passes[p];
+			out << "        {\"name\": \"" << escaped(pass.name) << "\", \"frames\": " << pass.cpu.values.size()
+				<< ",\n         \"cpu_ms\": " << statistics(pass.cpu.values);
+			// the simulation step has no GPU part
+			if (!pass.gpu.values.empty())
+				out << ",\n         \"gpu_ms\": " << statistics(pass.gpu.values);
+			out << "}"
+				<< (p + 1 < result.passes.size() ? "," : "") << "\n";
+		}
+		out << "      ]\n";
+		out << "    }" << (r + 1 < results.size() ? "," : "") << "\n";
+	}
+	out << "  ],\n";
+	out << "  \"regression\": {\"baseline\": \"" << escaped(settings.baseline) << "\", \"threshold\": "
+		<< settings.threshold << ", \"passed\": " << (passed ? "true" : "false") << ", \"failures\": [";
+	for (size_t i = 0; i < failures.size(); ++i)
+		out << (i ? ", " : "") << "\"" << escaped(failures[i]) << "\"";
+	out << "]}\n";
+	out << "}\n";
+
+	std::cout << "BENCHMARK " << (passed ? "passed" : "FAILED") << ", results in " << settings.output << std::endl;
+	return passed;
+}
@@ -22,14 +22,17 @@
 
 #include <time.h>
 #include <math.h>
+#include <chrono>
 
 #include "TrainWindow.H"
 #include "TrainView.H"
 #include "CallBacks.H"
+#include "Utilities/SimdMath.H"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
 #pragma warning(disable:4311)
+#include <Fl/Fl.h>
 #include <Fl/Fl_File_Chooser.H>
 #include <Fl/math.h>
 #pragma warning(pop)
@@ -122,25 +125,80 @@ void backCB(Fl_Widget*, TrainWindow* tw)
 
 
 
-static unsigned long lastRedraw = 0;
 //***************************************************************************
 //
-// * Callback for idling - if things are sitting, this gets called
-// if the run button is pushed, then we need to make the train go.
-// This is taken from the old "RunButton" demo.
-// another nice problem to have - most likely, we'll be too fast
-// don't draw more than 30 times per second
+// * Timer callback, runs renderRate times per second
+// if the run button is pushed, run the simulation steps that are due and
+// redraw. The steps come from a fixed timestep clock, so the simulation
+// speed does not depend on the redraw rate; the frame in between two
+// steps is drawn at the interpolated time.
 //===========================================================================
 void runButtonCB(TrainWindow* tw)
 //===========================================================================
 {
+	SimulationClock& clock = tw->simulationClock;
+
 	if (tw->runButton->value()) {	// only advance time if appropriate
-		if (clock() - lastRedraw > CLOCKS_PER_SEC/30) {
-			lastRedraw = clock();
+		int steps = clock.advance();
+		for (int i = 0; i < steps; ++i)
 			tw->advanceTrain();
-			tw->damageMe();
-		}
+
+		// only the sine wave reads t_time continuously
+		tw->trainView->renderTimeOffset = tw->waveBrowser->value() == 1 ?
+			(float)(clock.alpha() * clock.stepSeconds()) * WAVE_TIME_RATE : 0.0f;
+		tw->damageMe();
+	}
+	else {
+		// don't catch up on the time spent paused
+		clock.start();
+		tw->trainView->renderTimeOffset = 0.0f;
 	}
+
+	Fl::repeat_timeout(clock.renderInterval(), (Fl_Timeout_Handler)runButtonCB, tw);
+}
+
+//***************************************************************************
+//
+// * Idle callback while a benchmark runs
+// sets up the next scripted frame (camera, drops, one simulation step)
+// once the previous one has been drawn, so every frame is exactly one
+// step however long it took. Closes the window when the benchmark is done.
+//===========================================================================
+void benchmarkCB(TrainWindow* tw)
+//===========================================================================
+{
+	TrainView* view = tw->trainView;
+	Benchmark* benchmark = tw->benchmark;
+
+	// wait for the first frame to create everything, then for each draw
+	if (!view->waterFrameBuffers || view->benchmarkFramePending)
+		return;
+
+	if (!benchmark->advance()) {
+		Fl::remove_idle((Fl_Idle_Handler)benchmarkCB, tw);
+		tw->benchmarkPassed = benchmark->finish(view->renderer, view->pixel_w(), view->pixel_h());
+		tw->hide();
+		return;
+	}
+
+	if (benchmark->modeStarted()) {
+		tw->waveBrowser->select(benchmark->mode());
+		tw->resetWaves();
+	}
+
+	view->arcball.setPose(benchmark->pose());
+
+	std::vector<ScheduledDrop> drops;
+	benchmark->dropsThisFrame(drops);
+	for (size_t i = 0; i < drops.size(); ++i)
+		view->addDropAt(glm::vec2(drops[i].u, drops[i].v), drops[i].radius, drops[i].keepTime);
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	tw->advanceTrain();
+	benchmark->simulated(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+
+	view->benchmarkFramePending = true;
+	tw->damageMe();
 }
 
 //***************************************************************************
@@ -178,11 +236,8 @@ void rollx(TrainWindow* tw, float dir)
 {
 	int s = tw->trainView->selectedCube;
 	if (s >= 0) {
-		Pnt3f old = tw->m_Track.points[s].orient;
-		float si = sin(((float)M_PI_4) * dir);
-		float co = cos(((float)M_PI_4) * dir);
-		tw->m_Track.points[s].orient.y = co * old.y - si * old.z;
-		tw->m_Track.points[s].orient.z = si * old.y + co * old.z;
+		Pnt3f& orient = tw->m_Track.points[s].orient;
+		orient = Mat4::rotateX(((float)M_PI_4) * dir).transformVector(orient);
 	}
 	tw->damageMe();
 } 
@@ -215,14 +270,8 @@ void rollz(TrainWindow* tw, float dir)
 {
 	int s = tw->trainView->selectedCube;
 	if (s >= 0) {
-
-		Pnt3f old = tw->m_Track.points[s].orient;
-
-		float si = sin(((float)M_PI_4) * dir);
-		float co = cos(((float)M_PI_4) * dir);
-
-		tw->m_Track.points[s].orient.y = co * old.y - si * old.x;
-		tw->m_Track.points[s].orient.x = si * old.y + co * old.x;
+		Pnt3f& orient = tw->m_Track.points[s].orient;
+		orient = Mat4::rotateZ(-((float)M_PI_4) * dir).transformVector(orient);
 	}
 
 	tw->damageMe();
@@ -0,0 +1,121 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <chrono>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../Utilities/ThreadPool.H"
+#include "../Utilities/TraceRecorder.H"
+
+// Decodes every image of the scene concurrently on the shared ThreadPool
+// and hands the pixels to the GL thread for upload.
+//
+// queue() starts decoding straight away; upload() blocks until that image
+// is ready and runs the GL upload on the calling thread. Both steps are
+// timed per asset and printed by report(), and traced as "decode", "wait"
+// and "upload" events named after the file.
+class AssetLoader
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	// queueing the same path twice decodes it once
+	void queue(const std::string& path, int flags = cv::IMREAD_COLOR)
+	{
+		if (this->assets.count(path))
+			return;
+
+		Asset& asset = this->assets[path];
+		asset.image = ThreadPool::shared().submit([path, flags]() {
+			TraceRecorder::Scope traced("decode", fileName(path));
+			Decoded decoded;
+			Clock::time_point start = Clock::now();
+			decoded.image = cv::imread(path, flags);
+			decoded.decodeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			return decoded;
+		}).share();
+	}
+
+	// wait for the decoded image and upload it with upload_function(const cv::Mat&)
+	template <class F>
+	void upload(const std::string& path, F upload_function)
+	{
+		if (!this->assets.count(path))
+			this->queue(path);
+		Asset& asset = this->assets[path];
+
+		TraceRecorder& trace = TraceRecorder::shared();
+		int64_t waitStart = trace.now();
+		Clock::time_point start = Clock::now();
+		const Decoded& decoded = asset.image.get();
+		Clock::time_point ready = Clock::now();
+		trace.record("wait", fileName(path), waitStart, trace.now());
+
+		if (decoded.image.empty())
+			std::cout << "Asset failed to load at path: " << path << std::endl;
+		{
+			TraceRecorder::Scope traced("upload", fileName(path));
+			upload_function(decoded.image);
+		}
+
+		asset.waitMs += std::chrono::duration<double, std::milli>(ready - start).count();
+		asset.uploadMs += std::chrono::duration<double, std::milli>(Clock::now() - ready).count();
+	}
+
+	// the decoded pixels, blocking until they are ready
+	const cv::Mat& image(const std::string& path)
+	{
+		if (!this->assets.count(path))
+			this->queue(path);
+		return this->assets[path].image.get().image;
+	}
+
+	void report(std::ostream& out) const
+	{
+		double decode = 0.0, wait = 0.0, upload = 0.0;
+		out << "ASSETS::LOADED " << this->assets.size() << " images on "
+			<< ThreadPool::shared().size() << " threads" << std::endl;
+		out << std::fixed << std::setprecision(2);
+		for (std::map<std::string, Asset>::const_iterator it = this->assets.begin(); it != this->assets.end(); ++it)
+		{
+			const Decoded& decoded = it->second.image.get();
+			out << "  decode " << std::setw(8) << decoded.decodeMs << " ms"
+				<< "  wait " << std::setw(8) << it->second.waitMs << " ms"
+				<< "  upload " << std::setw(8) << it->second.uploadMs << " ms  " << it->first << std::endl;
+			decode += decoded.decodeMs;
+			wait += it->second.waitMs;
+			upload += it->second.uploadMs;
+		}
+		out << "  total decode " << decode << " ms (across workers), wait " << wait
+			<< " ms, upload " << upload << " ms" << std::endl;
+		out.unsetf(std::ios::floatfield);
+	}
+
+private:
+	// the name of the file without its directory, for the trace
+	static const char* fileName(const std::string& path)
+	{
+		size_t slash = path.find_last_of("/\\");
+		return path.c_str() + (slash == std::string::npos ? 0 : slash + 1);
+	}
+
+	struct Decoded
+	{
+		cv::Mat image;
+		double decodeMs = 0.0;
+	};
+	struct Asset
+	{
+		std::shared_future<Decoded> image;
+		double waitMs = 0.0;	// GL thread blocked on the decode
+		double uploadMs = 0.0;	// GL thread inside the upload
+	};
+
+	std::map<std::string, Asset> assets;
+};
@@ -1,5 +1,5 @@
 #pragma once
-#include <glad\glad.h>
+#include <glad/glad.h>
 
 #define MAX_FBO_TEXTURE_AMOUNT 4
 #define MAX_VAO_VBO_AMOUNT 3
@@ -14,6 +14,7 @@ struct VAO
 		unsigned int element_amount;//for draw element
 		unsigned int count;			//for draw array
 	};
+	GLenum element_type = GL_UNSIGNED_INT;	//index type for draw element
 };
 struct UBO
 {
@@ -0,0 +1,66 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <string.h>
+
+#include "../Utilities/SimdMath.H"
+
+// View and projection of one render pass, kept on the CPU so nothing has
+// to read them back from the fixed-function matrix stacks
+class Camera
+{
+public:
+	Camera()
+	{
+		this->set(glm::mat4(1.0f), glm::mat4(1.0f));
+	}
+
+	void set(const glm::mat4& view, const glm::mat4& projection)
+	{
+		this->view = view;
+		this->projection = projection;
+		// views are affine, which the cheaper inverse relies on
+		this->inverseView = toGlm(Mat4(&view[0][0]).affineInverse());
+		this->position = glm::vec3(this->inverseView[3]);
+	}
+
+	// view of the same camera mirrored in the horizontal plane y = height
+	glm::mat4 reflectedView(float height) const
+	{
+		Mat4 mirror = Mat4::translate(0.0f, height, 0.0f) * Mat4::scale(1.0f, -1.0f, 1.0f)
+					* Mat4::translate(0.0f, -height, 0.0f);
+		return toGlm(Mat4(&this->view[0][0]) * mirror);
+	}
+
+	// the camera seen in a mirror at y = height
+	Camera reflected(float height) const
+	{
+		Camera mirrored;
+		mirrored.set(this->reflectedView(height), this->projection);
+		return mirrored;
+	}
+
+	// load the matrices for the fixed-function drawing that still uses them
+	void load() const
+	{
+		glMatrixMode(GL_PROJECTION);
+		glLoadMatrixf(&this->projection[0][0]);
+		glMatrixMode(GL_MODELVIEW);
+		glLoadMatrixf(&this->view[0][0]);
+	}
+
+	glm::mat4 view;
+	glm::mat4 projection;
+	glm::mat4 inverseView;
+	glm::vec3 position;		// eye in world space
+
+private:
+	static glm::mat4 toGlm(const Mat4& m)
+	{
+		glm::mat4 r;
+		memcpy(&r[0][0], m.m, sizeof(m.m));
+		return r;
+	}
+};
@@ -0,0 +1,38 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// upper bound of live drops; must match MAX_DROPS in shaders/include/drops.glsl
+// and WaterSurface::MAX_RIPPLES
+#define MAX_DROP_AMOUNT 64
+
+struct Drop
+{
+	Drop(glm::vec2 p, float t, float r, float k)
+		:point(p), time(t), radius(r), keepTime(k)
+	{
+	}
+
+	glm::vec2 point;
+	float time;
+	float radius;
+	float keepTime;
+};
+
+// std140 mirror of one entry of the drops uniform block in shaders/include/drops.glsl
+struct DropData
+{
+	glm::vec2 point;
+	float time;
+	float radius;
+	float keepTime;
+	float padding[3];
+};
+
+// std140 mirror of the whole drops uniform block
+struct DropBlock
+{
+	GLint amount;
+	GLint padding[3];
+	DropData drops[MAX_DROP_AMOUNT];
+};
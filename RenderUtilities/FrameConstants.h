@@ -0,0 +1,131 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string.h>
+
+#include <iostream>
+#include <vector>
+
+#include "BufferObject.h"
+
+// std140 mirror of the commom_matrices uniform block in the shaders
+struct FrameConstantsBlock
+{
+	glm::mat4 projection;
+	glm::mat4 view;
+	glm::vec4 cameraPosition;	// w unused
+	glm::vec4 lightPosition;	// w unused
+	glm::vec4 lightColor;		// w unused
+	float time;
+	float padding[3];
+};
+
+// Ring of per-pass constant blocks in one uniform buffer that is allocated
+// and mapped once.
+//
+// Every pass writes its own slot and binds just that range, so nothing
+// the GPU may still read is overwritten. The slots of a frame are only
+// reused framesInFlight frames later, after that frame's fence.
+//
+// With GL 4.4 or ARB_buffer_storage the buffer stays mapped (persistent,
+// coherent) and push() is a memcpy; otherwise each slot is written with
+// glBufferSubData.
+class FrameConstants
+{
+public:
+	FrameConstants(int passesPerFrame = 3, int framesInFlight = 3):
+		passesPerFrame(passesPerFrame), framesInFlight(framesInFlight)
+	{
+		GLint alignment = 256;
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		this->stride = (sizeof(FrameConstantsBlock) + alignment - 1) / alignment * alignment;
+		this->fences.assign(framesInFlight, nullptr);
+
+		GLsizeiptr size = this->stride * passesPerFrame * framesInFlight;
+		glGenBuffers(1, &this->buffer.ubo);
+		this->buffer.size = size;
+		glBindBuffer(GL_UNIFORM_BUFFER, this->buffer.ubo);
+		if (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage)
+		{
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(GL_UNIFORM_BUFFER, size, nullptr, flags);
+			this->mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, size, flags);
+		}
+		else
+			glBufferData(GL_UNIFORM_BUFFER, size, nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	}
+
+	~FrameConstants()
+	{
+		for (size_t i = 0; i < this->fences.size(); ++i)
+			if (this->fences[i])
+				glDeleteSync(this->fences[i]);
+		if (this->mapped)
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, this->buffer.ubo);
+			glUnmapBuffer(GL_UNIFORM_BUFFER);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glDeleteBuffers(1, &this->buffer.ubo);
+	}
+
+	// move on to the next frame's slots, waiting until the GPU is done
+	// with the frame that used them last
+	void beginFrame()
+	{
+		this->frame = (this->frame + 1) % this->framesInFlight;
+		this->pass = 0;
+
+		GLsync& fence = this->fences[this->frame];
+		if (fence)
+		{
+			GLbitfield flags = GL_SYNC_FLUSH_COMMANDS_BIT;
+			while (glClientWaitSync(fence, flags, 1000000) == GL_TIMEOUT_EXPIRED)
+				flags = 0;
+			glDeleteSync(fence);
+			fence = nullptr;
+		}
+	}
+
+	// write the constants of the next pass and bind them to binding
+	void push(const FrameConstantsBlock& block, GLuint binding = 0)
+	{
+		if (this->pass >= this->passesPerFrame)
+		{
+			// more passes than the ring was sized for, the last slot is
+			// shared and the GPU may see the newer values
+			std::cout << "ERROR::FRAME_CONSTANTS::TOO_MANY_PASSES" << std::endl;
+			this->pass = this->passesPerFrame - 1;
+		}
+
+		GLintptr offset = (GLintptr)this->stride * (this->frame * this->passesPerFrame + this->pass);
+		if (this->mapped)
+			memcpy(this->mapped + offset, &block, sizeof(FrameConstantsBlock));
+		else
+		{
+			glBindBuffer(GL_UNIFORM_BUFFER, this->buffer.ubo);
+			glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(FrameConstantsBlock), &block);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
+		glBindBufferRange(GL_UNIFORM_BUFFER, binding, this->buffer.ubo, offset, sizeof(FrameConstantsBlock));
+		++this->pass;
+	}
+
+	// fence this frame's slots, call after its last draw
+	void endFrame()
+	{
+		this->fences[this->frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+
+	UBO buffer;
+	int passesPerFrame;
+	int framesInFlight;
+private:
+	GLsizeiptr stride = 0;
+	unsigned char* mapped = nullptr;
+	std::vector<GLsync> fences;
+	int frame = 0;
+	int pass = 0;
+};
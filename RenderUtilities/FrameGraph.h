@@ -0,0 +1,123 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "PassTimer.h"
+
+// Passes of one frame and the render targets they write and sample.
+//
+// Every frame the passes are declared again with the targets they read and
+// write. execute() walks back from the passes marked as output (the
+// screen) and runs, in declaration order, only the passes whose targets
+// somebody still reads. A pass writing a target that nothing samples this
+// frame is culled, together with everything that only fed it.
+class FrameGraph
+{
+public:
+	typedef std::function<void()> Execute;
+
+	// a render target passes can write and read, valid across frames
+	int addTarget(const char* name)
+	{
+		this->targetNames.push_back(name);
+		return (int)this->targetNames.size() - 1;
+	}
+
+	// forget last frame's passes, keeps the targets and the storage
+	void reset()
+	{
+		this->passCount = 0;
+	}
+
+	// declare a pass, output passes always run
+	int addPass(const char* name, const Execute& execute, bool output = false)
+	{
+		if (this->passCount == (int)this->passes.size())
+			this->passes.push_back(Pass());
+		Pass& pass = this->passes[this->passCount];
+		pass.name = name;
+		pass.execute = execute;
+		pass.output = output;
+		pass.reads.clear();
+		pass.writes.clear();
+		return this->passCount++;
+	}
+
+	void read(int pass, int target)
+	{
+		this->passes[pass].reads.push_back(target);
+	}
+
+	void write(int pass, int target)
+	{
+		this->passes[pass].writes.push_back(target);
+	}
+
+	// run the passes that contribute to an output
+	void execute()
+	{
+		this->needed.assign(this->targetNames.size(), false);
+		for (int i = this->passCount - 1; i >= 0; --i)
+		{
+			Pass& pass = this->passes[i];
+			pass.live = pass.output;
+			for (size_t w = 0; w < pass.writes.size() && !pass.live; ++w)
+				pass.live = this->needed[pass.writes[w]];
+			if (!pass.live)
+				continue;
+			// the targets are written before they are read in declaration
+			// order, so a live pass makes its inputs needed for the
+			// passes declared before it
+			for (size_t w = 0; w < pass.writes.size(); ++w)
+				this->needed[pass.writes[w]] = false;
+			for (size_t r = 0; r < pass.reads.size(); ++r)
+				this->needed[pass.reads[r]] = true;
+		}
+
+		this->executed = this->culled = 0;
+		for (int i = 0; i < this->passCount; ++i)
+		{
+			if (this->passes[i].live)
+			{
+				if (this->timer)
+					this->timer->begin(this->passes[i].name.c_str());
+				this->passes[i].execute();
+				if (this->timer)
+					this->timer->end();
+				++this->executed;
+			}
+			else
+				++this->culled;
+		}
+	}
+
+	// whether pass ran in the last execute()
+	bool ran(int pass) const
+	{
+		return pass < this->passCount && this->passes[pass].live;
+	}
+
+	// passes run and culled by the last execute()
+	int executed = 0;
+	int culled = 0;
+
+	// times every pass that runs when set
+	PassTimer* timer = nullptr;
+
+private:
+	struct Pass
+	{
+		std::string name;
+		Execute execute;
+		bool output = false;
+		bool live = false;
+		std::vector<int> reads;
+		std::vector<int> writes;
+	};
+
+	std::vector<std::string> targetNames;
+	std::vector<Pass> passes;
+	std::vector<bool> needed;
+	int passCount = 0;
+};
@@ -0,0 +1,268 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <math.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "ShaderManager.h"
+
+// WaveSolver on the GPU: the same wave equation on the same grid, stepped
+// by compute shaders on images the heightmap shader samples directly, so
+// the heights never go through the CPU.
+//
+// Height and velocity are GL_R32F images, two of each that swap roles
+// every step. A step clamps to the border cells instead of filling a
+// ghost ring, which reflects the walls the same way, and does WaveSolver's
+// arithmetic in the same order without fused multiply-adds, so the
+// heights only drift from the CPU solver by the rounding of the cos and
+// sqrt of the drops.
+//
+// step(), addDrop() and reset() only record the work and need no context,
+// so the simulation can call them. update(), with the context current,
+// runs it as one chain of dispatches: the drops and steps in the order
+// they were asked for, then the slopes the vertex normals are made of.
+class GpuWaveSolver
+{
+public:
+	// width and height are the number of simulated cells; directory holds
+	// the wave*.comp shaders. manager may be null, then they build now
+	GpuWaveSolver(int width, int height, const std::string& directory, ShaderManager* manager):
+		width(width), height(height), managed(manager != nullptr)
+	{
+		std::string step = directory + "/waveStep.comp";
+		std::string drop = directory + "/waveDrop.comp";
+		std::string normals = directory + "/waveNormals.comp";
+		this->stepProgram = manager ? manager->submitCompute(step.c_str()) : new Shader(step.c_str());
+		this->dropProgram = manager ? manager->submitCompute(drop.c_str()) : new Shader(drop.c_str());
+		this->normalProgram = manager ? manager->submitCompute(normals.c_str()) : new Shader(normals.c_str());
+
+		// one layer arrays, so the heightmap shader samples them like the frames
+		for (int i = 0; i < 2; ++i)
+		{
+			this->heights[i] = this->createImage(GL_R32F);
+			this->velocities[i] = this->createImage(GL_R32F);
+		}
+		this->slopes = this->createImage(GL_RG32F);
+	}
+	~GpuWaveSolver()
+	{
+		glDeleteTextures(2, this->heights);
+		glDeleteTextures(2, this->velocities);
+		glDeleteTextures(1, &this->slopes);
+		// the ShaderManager keeps the ones it built
+		if (!this->managed)
+		{
+			delete this->stepProgram;
+			delete this->dropProgram;
+			delete this->normalProgram;
+		}
+	}
+
+	// compute shaders and image load/store
+	static bool supported()
+	{
+		return GLAD_GL_VERSION_4_3 != 0;
+	}
+
+	// advance the simulation by one tick
+	void step()
+	{
+		this->commands.push_back(Command());
+	}
+
+	// splat a drop centred at (u, v) in [0, 1] texture space, as
+	// WaveSolver::addDrop
+	void addDrop(float u, float v, float radius, float strength)
+	{
+		Command command;
+		command.drop = true;
+		command.u = u;
+		command.v = v;
+		command.radius = radius;
+		command.strength = strength;
+		this->commands.push_back(command);
+	}
+
+	// flatten the water, dropping whatever was not run yet
+	void reset()
+	{
+		this->commands.clear();
+		this->cleared = true;
+	}
+
+	// run the recorded work; the images are ready for the draw after it
+	void update()
+	{
+		if (this->cleared)
+		{
+			std::vector<float> zeros((size_t)this->width * this->height, 0.0f);
+			for (int i = 0; i < 2; ++i)
+			{
+				this->upload(this->heights[i], &zeros[0]);
+				this->upload(this->velocities[i], &zeros[0]);
+			}
+			this->current = 0;
+			this->cleared = false;
+			this->stale = true;
+		}
+		if (this->commands.empty() && !this->stale)
+			return;
+
+		for (size_t i = 0; i < this->commands.size(); ++i)
+		{
+			if (this->commands[i].drop)
+				this->splat(this->commands[i]);
+			else
+				this->advance();
+			// the next dispatch reads what this one wrote
+			glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+		}
+		this->commands.clear();
+
+		this->normalProgram->Use();
+		glBindImageTexture(0, this->heights[this->current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, this->slopes, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RG32F);
+		glDispatchCompute(this->groups(this->width), this->groups(this->height), 1);
+		// the vertex shader samples both images
+		glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+		glUseProgram(0);
+		this->stale = false;
+	}
+
+	// the latest heights and their slopes, as GL_TEXTURE_2D_ARRAY
+	void bindHeights(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->heights[this->current]);
+	}
+	void bindSlopes(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->slopes);
+	}
+
+	// read the heights back into a tightly packed width*height array,
+	// after update(); for comparing with WaveSolver, it waits for the GPU
+	void copyHeights(float* out)
+	{
+		glMemoryBarrier(GL_TEXTURE_UPDATE_BARRIER_BIT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->heights[this->current]);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glGetTexImage(GL_TEXTURE_2D_ARRAY, 0, GL_RED, GL_FLOAT, out);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	int getWidth() const { return this->width; }
+	int getHeight() const { return this->height; }
+
+	// as in WaveSolver
+	float stiffness = 0.5f;
+	float damping = 0.995f;
+
+private:
+	struct Command
+	{
+		bool drop = false;		// a step otherwise
+		float u = 0.0f, v = 0.0f;
+		float radius = 0.0f;
+		float strength = 0.0f;
+	};
+
+	enum { GROUP_SIZE = 8 };	// local_size of the wave*.comp shaders
+
+	GLuint groups(int cells) const
+	{
+		return (GLuint)((cells + GROUP_SIZE - 1) / GROUP_SIZE);
+	}
+
+	GLuint createImage(GLenum internal_format)
+	{
+		GLuint id;
+		glGenTextures(1, &id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, internal_format, this->width, this->height, 1);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+		// storage starts undefined
+		if (internal_format == GL_R32F)
+		{
+			std::vector<float> zeros((size_t)this->width * this->height, 0.0f);
+			this->upload(id, &zeros[0]);
+		}
+		return id;
+	}
+
+	void upload(GLuint id, const float* pixels)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, this->width, this->height, 1, GL_RED, GL_FLOAT, pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	// the cells WaveSolver::addDrop touches, one invocation each
+	void splat(const Command& drop)
+	{
+		float cx = drop.u * (this->width - 1);
+		float cy = drop.v * (this->height - 1);
+		float r = drop.radius * std::max(this->width, this->height);
+		if (r < 1.0f)
+			r = 1.0f;
+
+		int x0 = std::max(0, (int)floor(cx - r));
+		int x1 = std::min(this->width - 1, (int)ceil(cx + r));
+		int y0 = std::max(0, (int)floor(cy - r));
+		int y1 = std::min(this->height - 1, (int)ceil(cy + r));
+		if (x1 < x0 || y1 < y0)
+			return;
+
+		this->dropProgram->Use();
+		this->dropProgram->setIVec2("origin", glm::ivec2(x0, y0));
+		this->dropProgram->setIVec2("size", glm::ivec2(x1 - x0 + 1, y1 - y0 + 1));
+		this->dropProgram->setVec2("center", glm::vec2(cx, cy));
+		this->dropProgram->setFloat("radius", r);
+		this->dropProgram->setFloat("strength", drop.strength);
+		glBindImageTexture(0, this->heights[this->current], 0, GL_FALSE, 0, GL_READ_WRITE, GL_R32F);
+		glDispatchCompute(this->groups(x1 - x0 + 1), this->groups(y1 - y0 + 1), 1);
+	}
+
+	// one tick from the current images into the other pair
+	void advance()
+	{
+		this->stepProgram->Use();
+		this->stepProgram->setFloat("stiffness", std::min(std::max(this->stiffness, 0.0f), 0.5f));
+		this->stepProgram->setFloat("damping", this->damping);
+		glBindImageTexture(0, this->heights[this->current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(1, this->velocities[this->current], 0, GL_FALSE, 0, GL_READ_ONLY, GL_R32F);
+		glBindImageTexture(2, this->heights[this->current ^ 1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glBindImageTexture(3, this->velocities[this->current ^ 1], 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+		glDispatchCompute(this->groups(this->width), this->groups(this->height), 1);
+		this->current ^= 1;
+	}
+
+	int width;
+	int height;
+	bool managed;						// the programs came from a ShaderManager
+
+	Shader* stepProgram;
+	Shader* dropProgram;
+	Shader* normalProgram;
+
+	GLuint heights[2];
+	GLuint velocities[2];
+	GLuint slopes;
+	int current = 0;					// which pair holds the latest state
+
+	std::vector<Command> commands;		// recorded, not run yet
+	bool cleared = false;				// reset() since the last update()
+	bool stale = true;					// the slopes are older than the heights
+};
@@ -0,0 +1,122 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+#include "BufferObject.h"
+
+// one lattice point of the water grid, interleaved so the whole mesh
+// lives in a single vertex buffer
+struct GridVertex
+{
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec2 texture_coordinate;
+};
+
+// Builds a welded (N+1)x(N+1) vertex lattice on the y = height plane,
+// covering [-size/2, size/2] in x and z. Neighbouring quads share their
+// corners, so every vertex is transformed once and the post-transform
+// cache can reuse it. Texture coordinates run 0..1 across the whole grid.
+class GridMesh
+{
+public:
+	GridMesh(unsigned int resolution, float size = 2.0f, float height = 0.6f)
+		:resolution(resolution)
+	{
+		unsigned int side = resolution + 1;
+		float step = size / resolution;
+
+		this->vertices.resize(side * side);
+		for (unsigned int h = 0; h < side; ++h)
+		{
+			for (unsigned int w = 0; w < side; ++w)
+			{
+				GridVertex& v = this->vertices[h * side + w];
+				v.position = glm::vec3(w * step - size * 0.5f, height, h * step - size * 0.5f);
+				v.normal = glm::vec3(0.0f, 1.0f, 0.0f);
+				v.texture_coordinate = glm::vec2((float)w / resolution, (float)h / resolution);
+			}
+		}
+
+		// same winding as the old per-quad mesh: (1, 0, 3), (3, 2, 1)
+		// where 0 is the (+x, +z) corner of the quad
+		this->elements.resize(resolution * resolution * 6);
+		for (unsigned int h = 0, i = 0; h < resolution; ++h)
+		{
+			for (unsigned int w = 0; w < resolution; ++w, i += 6)
+			{
+				GLuint c0 = (h + 1) * side + (w + 1);
+				GLuint c1 = (h + 1) * side + w;
+				GLuint c2 = h * side + w;
+				GLuint c3 = h * side + (w + 1);
+
+				this->elements[i] = c1;
+				this->elements[i + 1] = c0;
+				this->elements[i + 2] = c3;
+
+				this->elements[i + 3] = c3;
+				this->elements[i + 4] = c2;
+				this->elements[i + 5] = c1;
+			}
+		}
+	}
+
+	// 16-bit indices are enough as long as every vertex is addressable
+	bool useShortElements() const
+	{
+		return this->vertices.size() <= 65536;
+	}
+
+	// upload the lattice into one interleaved VBO and an EBO
+	VAO* createVAO() const
+	{
+		VAO* mesh = new VAO;
+		mesh->element_amount = (unsigned int)this->elements.size();
+		glGenVertexArrays(1, &mesh->vao);
+		glGenBuffers(1, mesh->vbo);
+		glGenBuffers(1, &mesh->ebo);
+
+		glBindVertexArray(mesh->vao);
+
+		glBindBuffer(GL_ARRAY_BUFFER, mesh->vbo[0]);
+		glBufferData(GL_ARRAY_BUFFER, this->vertices.size() * sizeof(GridVertex), this->vertices.data(), GL_STATIC_DRAW);
+
+		// Position attribute
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(GridVertex), (GLvoid*)offsetof(GridVertex, position));
+		glEnableVertexAttribArray(0);
+
+		// Normal attribute
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(GridVertex), (GLvoid*)offsetof(GridVertex, normal));
+		glEnableVertexAttribArray(1);
+
+		// Texture Coordinate attribute
+		glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(GridVertex), (GLvoid*)offsetof(GridVertex, texture_coordinate));
+		glEnableVertexAttribArray(2);
+
+		//Element attribute
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh->ebo);
+		if (this->useShortElements())
+		{
+			std::vector<GLushort> shortElements(this->elements.begin(), this->elements.end());
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortElements.size() * sizeof(GLushort), shortElements.data(), GL_STATIC_DRAW);
+			mesh->element_type = GL_UNSIGNED_SHORT;
+		}
+		else
+		{
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, this->elements.size() * sizeof(GLuint), this->elements.data(), GL_STATIC_DRAW);
+			mesh->element_type = GL_UNSIGNED_INT;
+		}
+
+		// Unbind VAO
+		glBindVertexArray(0);
+
+		return mesh;
+	}
+
+	unsigned int resolution;
+	std::vector<GridVertex> vertices;
+	std::vector<GLuint> elements;
+};
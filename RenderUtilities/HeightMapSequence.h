@@ -0,0 +1,260 @@
+#pragma once
+// Packed heightmap sequence (*.hmsq)
+//
+// One file holds every frame of a heightmap animation as tightly packed
+// single-channel rows, so loading it is one mapping instead of hundreds of
+// image decodes. tools/HeightMapBaker.cpp writes it from a frame directory.
+//
+//   HeightMapSequenceHeader
+//   HeightMapSequenceFrame[frameCount]	offset/size of each frame
+//   frame data						raw, or LZ4 blocks when HMSQ_LZ4 is set
+//
+// The reader maps the file read-only and hands out pointers straight into
+// the mapping. Compressed frames are decoded into a scratch buffer, which
+// needs HEIGHTMAP_SEQUENCE_LZ4 (and lz4.h) at build time.
+
+#include <stdint.h>
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+#ifdef HEIGHTMAP_SEQUENCE_LZ4
+	#include <lz4.h>
+#endif
+
+#define HMSQ_VERSION 1
+
+enum HeightMapSequenceFlags
+{
+	HMSQ_LZ4 = 1 << 0,
+};
+
+struct HeightMapSequenceHeader
+{
+	char magic[4];				// "HMSQ"
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frameCount;
+	uint32_t bytesPerPixel;		// 1 = R8, 2 = R16
+	uint32_t flags;
+	uint32_t reserved;
+};
+
+struct HeightMapSequenceFrame
+{
+	uint64_t offset;			// from the start of the file
+	uint64_t size;				// stored bytes (compressed size for LZ4)
+};
+
+class HeightMapSequence
+{
+public:
+	HeightMapSequence()
+	{
+		memset(&this->header, 0, sizeof(this->header));
+	}
+	HeightMapSequence(const HeightMapSequence&) = delete;
+	HeightMapSequence& operator=(const HeightMapSequence&) = delete;
+	~HeightMapSequence()
+	{
+		this->close();
+	}
+
+	// map the file, false if it is missing or not a valid sequence
+	bool open(const std::string& path)
+	{
+		this->close();
+		if (!this->map(path))
+			return false;
+
+		if (this->length < sizeof(HeightMapSequenceHeader))
+		{
+			this->close();
+			return false;
+		}
+		memcpy(&this->header, this->data, sizeof(HeightMapSequenceHeader));
+
+		size_t tableRoom = (this->length - sizeof(HeightMapSequenceHeader)) / sizeof(HeightMapSequenceFrame);
+		if (memcmp(this->header.magic, "HMSQ", 4) != 0 || this->header.version != HMSQ_VERSION
+			|| this->header.width == 0 || this->header.height == 0 || this->header.frameCount == 0
+			|| (this->header.bytesPerPixel != 1 && this->header.bytesPerPixel != 2)
+			|| this->header.frameCount > tableRoom)
+		{
+			std::cout << "ERROR::HEIGHTMAP_SEQUENCE::INVALID_FILE " << path << std::endl;
+			this->close();
+			return false;
+		}
+#ifndef HEIGHTMAP_SEQUENCE_LZ4
+		if (this->header.flags & HMSQ_LZ4)
+		{
+			std::cout << "ERROR::HEIGHTMAP_SEQUENCE::LZ4_NOT_SUPPORTED " << path << std::endl;
+			this->close();
+			return false;
+		}
+#endif
+		this->frames = (const HeightMapSequenceFrame*)(this->data + sizeof(HeightMapSequenceHeader));
+		for (uint32_t i = 0; i < this->header.frameCount; ++i)
+		{
+			const HeightMapSequenceFrame& frame = this->frames[i];
+			if (frame.offset > this->length || frame.size > this->length - frame.offset)
+			{
+				std::cout << "ERROR::HEIGHTMAP_SEQUENCE::TRUNCATED " << path << std::endl;
+				this->close();
+				return false;
+			}
+			// frame() and copyFrame() read frameBytes() of a raw frame, and
+			// LZ4 never stores a frame in more than its bound
+			if (!this->storedSizeValid(frame.size))
+			{
+				std::cout << "ERROR::HEIGHTMAP_SEQUENCE::BAD_FRAME_SIZE " << i << " " << path << std::endl;
+				this->close();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (this->data)
+			UnmapViewOfFile(this->data);
+		if (this->mapping)
+			CloseHandle(this->mapping);
+		if (this->file != INVALID_HANDLE_VALUE)
+			CloseHandle(this->file);
+		this->mapping = NULL;
+		this->file = INVALID_HANDLE_VALUE;
+#else
+		if (this->data)
+			munmap((void*)this->data, this->length);
+#endif
+		this->data = nullptr;
+		this->length = 0;
+		this->frames = nullptr;
+		memset(&this->header, 0, sizeof(this->header));
+	}
+
+	bool isOpen() const { return this->data != nullptr; }
+
+	// tightly packed pixels of one frame
+	// points into the mapping unless the file is compressed
+	const unsigned char* frame(uint32_t index)
+	{
+		const unsigned char* stored = this->data + this->frames[index].offset;
+		if (!(this->header.flags & HMSQ_LZ4))
+			return stored;
+#ifdef HEIGHTMAP_SEQUENCE_LZ4
+		this->scratch.resize(this->frameBytes());
+		int decoded = LZ4_decompress_safe((const char*)stored, (char*)&this->scratch[0],
+			(int)this->frames[index].size, (int)this->scratch.size());
+		if (decoded != (int)this->scratch.size())
+		{
+			// a corrupt block reads as flat water rather than stale pixels
+			std::cout << "ERROR::HEIGHTMAP_SEQUENCE::CORRUPT_FRAME " << index << std::endl;
+			memset(&this->scratch[0], 0, this->scratch.size());
+		}
+		return &this->scratch[0];
+#else
+		return nullptr;
+#endif
+	}
+
+	// decode one frame into out, which holds frameBytes()
+	// safe to call from any thread as long as every thread has its own out
+	bool copyFrame(uint32_t index, unsigned char* out) const
+	{
+		const unsigned char* stored = this->data + this->frames[index].offset;
+		if (!(this->header.flags & HMSQ_LZ4))
+		{
+			memcpy(out, stored, this->frameBytes());
+			return true;
+		}
+#ifdef HEIGHTMAP_SEQUENCE_LZ4
+		return LZ4_decompress_safe((const char*)stored, (char*)out,
+			(int)this->frames[index].size, (int)this->frameBytes()) == (int)this->frameBytes();
+#else
+		return false;
+#endif
+	}
+
+	size_t frameBytes() const
+	{
+		return (size_t)this->header.width * this->header.height * this->header.bytesPerPixel;
+	}
+
+	HeightMapSequenceHeader header;
+
+private:
+	bool storedSizeValid(uint64_t size) const
+	{
+		if (!(this->header.flags & HMSQ_LZ4))
+			return size == this->frameBytes();
+#ifdef HEIGHTMAP_SEQUENCE_LZ4
+		return size > 0 && this->frameBytes() <= (size_t)LZ4_MAX_INPUT_SIZE
+			&& size <= (uint64_t)LZ4_compressBound((int)this->frameBytes());
+#else
+		return false;
+#endif
+	}
+
+	bool map(const std::string& path)
+	{
+#ifdef _WIN32
+		this->file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		if (this->file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		GetFileSizeEx(this->file, &size);
+		this->length = (size_t)size.QuadPart;
+		this->mapping = CreateFileMappingA(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (!this->mapping)
+		{
+			this->close();
+			return false;
+		}
+		this->data = (const unsigned char*)MapViewOfFile(this->mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat info;
+		if (fstat(fd, &info) != 0 || info.st_size == 0)
+		{
+			::close(fd);
+			return false;
+		}
+		this->length = (size_t)info.st_size;
+		void* mapped = mmap(NULL, this->length, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (mapped == MAP_FAILED)
+			return false;
+		// the whole file is read front to back once
+		madvise(mapped, this->length, MADV_SEQUENTIAL);
+		this->data = (const unsigned char*)mapped;
+#endif
+		return this->data != nullptr;
+	}
+
+	const unsigned char* data = nullptr;
+	size_t length = 0;
+	const HeightMapSequenceFrame* frames = nullptr;
+	std::vector<unsigned char> scratch;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#endif
+};
@@ -0,0 +1,252 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "HeightMapSequence.h"
+#include "TextureArray.h"
+#include "../Utilities/TraceRecorder.H"
+
+// Keeps only a window of heightmap frames on the GPU instead of the whole
+// sequence, so the memory used doesn't grow with the sequence length.
+//
+// Frame f lives in layer f % window of a small texture array. A reader
+// thread copies upcoming frames out of the HeightMapSequence into slots of
+// a persistently mapped pixel buffer. update() turns finished slots into
+// texture uploads on the GL thread and fences them, so a slot is only
+// refilled once the GPU has consumed it.
+//
+// Needs GL 4.4 or ARB_buffer_storage, see supported().
+class HeightMapStream
+{
+public:
+	// the sequence must stay open for as long as the stream lives
+	// window is the number of resident frames, slotCount the number of frames
+	// that can be in flight between the reader and the GPU
+	HeightMapStream(HeightMapSequence& sequence, int window = 16, int slotCount = 4):
+		window(window), sequence(sequence), slots(slotCount)
+	{
+		const HeightMapSequenceHeader& header = sequence.header;
+		if (this->window > (int)header.frameCount)
+			this->window = (int)header.frameCount;
+		this->frameBytes = sequence.frameBytes();
+
+		this->texture = new Texture2DArray(header.width, header.height, this->window,
+										   header.bytesPerPixel == 2 ? GL_R16 : GL_R8);
+		this->texture->setWrap(GL_REPEAT);
+
+		// the first window is uploaded up front so the water never starts empty
+		this->resident.assign(this->window, -1);
+		for (int i = 0; i < this->window; ++i)
+		{
+			this->texture->upload(i, sequence.frame(i));
+			this->resident[i] = i;
+		}
+		this->shownLayer = 0;
+
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glGenBuffers(1, &this->pbo);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, this->frameBytes * slotCount, nullptr, flags);
+		this->mapped = (unsigned char*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, this->frameBytes * slotCount, flags);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		for (int i = 0; i < slotCount; ++i)
+		{
+			this->slots[i].state = SLOT_FREE;
+			this->slots[i].frame = -1;
+			this->slots[i].fence = nullptr;
+		}
+
+		this->reader = std::thread(&HeightMapStream::read, this);
+	}
+
+	~HeightMapStream()
+	{
+		{
+			std::lock_guard<std::mutex> lock(this->mutex);
+			this->stopping = true;
+		}
+		this->wake.notify_all();
+		this->reader.join();
+
+		for (size_t i = 0; i < this->slots.size(); ++i)
+			if (this->slots[i].fence)
+				glDeleteSync(this->slots[i].fence);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		glDeleteBuffers(1, &this->pbo);
+		delete this->texture;
+	}
+
+	static bool supported()
+	{
+		return GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+	}
+
+	// call once per frame on the GL thread with the frame about to be drawn
+	// returns the layer to sample: the frame itself when it is resident,
+	// otherwise the last frame that was
+	int update(unsigned int frame)
+	{
+		int frameCount = (int)this->sequence.header.frameCount;
+
+		// the window ahead of frame, nearest first; near the end of the
+		// sequence a wrapped frame can land on a layer a nearer one already
+		// claimed, those wait until the nearer one has been shown
+		std::vector<int> wanted(this->window, -1);
+		for (int k = 0; k < this->window; ++k)
+		{
+			int f = (int)((frame + k) % frameCount);
+			int layer = f % this->window;
+			if (wanted[layer] < 0)
+				wanted[layer] = f;
+		}
+
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, this->pbo);
+		for (size_t i = 0; i < this->slots.size(); ++i)
+		{
+			Slot& slot = this->slots[i];
+			int state = slot.state.load(std::memory_order_acquire);
+
+			// the GPU is done reading this slot
+			if (state == SLOT_UPLOADING)
+			{
+				GLenum status = glClientWaitSync(slot.fence, 0, 0);
+				if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+				{
+					glDeleteSync(slot.fence);
+					slot.fence = nullptr;
+					slot.state = SLOT_FREE;
+				}
+			}
+			// the reader is done filling this slot
+			else if (state == SLOT_READY)
+			{
+				int layer = slot.frame % this->window;
+				if (wanted[layer] != slot.frame)
+				{
+					// fell out of the window while it was being read
+					slot.state = SLOT_FREE;
+					continue;
+				}
+				this->texture->upload(layer, (const void*)(uintptr_t)(i * this->frameBytes));
+				this->resident[layer] = slot.frame;
+				slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+				slot.state = SLOT_UPLOADING;
+				++this->uploads;
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+		// hand the missing frames to the reader, nearest first
+		for (int k = 0; k < this->window; ++k)
+		{
+			int f = (int)((frame + k) % frameCount);
+			int layer = f % this->window;
+			if (wanted[layer] != f || this->resident[layer] == f || this->inFlight(f))
+				continue;
+			int free = this->freeSlot();
+			if (free < 0)
+				break;
+			this->slots[free].frame = f;
+			this->slots[free].state = SLOT_LOADING;
+			{
+				std::lock_guard<std::mutex> lock(this->mutex);
+				this->pending.push_back(free);
+			}
+			this->wake.notify_one();
+		}
+
+		int layer = (int)(frame % frameCount) % this->window;
+		if (this->resident[layer] == (int)(frame % frameCount))
+			this->shownLayer = layer;
+		else
+			++this->misses;
+		return this->shownLayer;
+	}
+
+	unsigned int frameCount() const { return this->sequence.header.frameCount; }
+
+	// frame a layer holds, -1 before its first upload
+	int frameIn(int layer) const { return this->resident[layer]; }
+
+	Texture2DArray* texture = nullptr;
+	int window;
+
+	unsigned int uploads = 0;	// frames streamed in
+	unsigned int misses = 0;	// frames drawn with an older layer because theirs wasn't ready
+
+private:
+	enum SlotState { SLOT_FREE, SLOT_LOADING, SLOT_READY, SLOT_UPLOADING };
+	struct Slot
+	{
+		std::atomic<int> state;
+		int frame;
+		GLsync fence;
+	};
+
+	bool inFlight(int frame) const
+	{
+		for (size_t i = 0; i < this->slots.size(); ++i)
+			if (this->slots[i].frame == frame && this->slots[i].state.load(std::memory_order_acquire) != SLOT_FREE)
+				return true;
+		return false;
+	}
+
+	int freeSlot() const
+	{
+		for (size_t i = 0; i < this->slots.size(); ++i)
+			if (this->slots[i].state.load(std::memory_order_acquire) == SLOT_FREE)
+				return (int)i;
+		return -1;
+	}
+
+	// reader thread: copy requested frames into their slot of the mapping
+	void read()
+	{
+		TraceRecorder::shared().nameThread("height map reader");
+		for (;;)
+		{
+			int index;
+			{
+				std::unique_lock<std::mutex> lock(this->mutex);
+				this->wake.wait(lock, [this]() { return this->stopping || !this->pending.empty(); });
+				if (this->stopping)
+					return;
+				index = this->pending.front();
+				this->pending.pop_front();
+			}
+			Slot& slot = this->slots[index];
+			TraceRecorder::Scope trace("stream", "read frame");
+			if (this->sequence.copyFrame(slot.frame, this->mapped + index * this->frameBytes))
+				slot.state.store(SLOT_READY, std::memory_order_release);
+			else
+				slot.state.store(SLOT_FREE, std::memory_order_release);
+		}
+	}
+
+	HeightMapSequence& sequence;
+	size_t frameBytes = 0;
+
+	std::vector<int> resident;		// frame held by each layer, -1 if none
+	int shownLayer = 0;
+
+	GLuint pbo = 0;
+	unsigned char* mapped = nullptr;
+	std::vector<Slot> slots;
+
+	std::thread reader;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<int> pending;		// slots waiting for the reader
+	bool stopping = false;
+};
@@ -0,0 +1,220 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "../Utilities/TraceRecorder.H"
+
+// CPU and GPU time of the named scopes of a frame: passes, and the draws
+// and uploads inside them.
+//
+// begin()/end() (or a Scope on the stack) put a GL_TIMESTAMP query on each
+// side of a scope. Scopes nest, which GL_TIME_ELAPSED queries cannot, and
+// they can sit inside the frame's own elapsed query. A nested scope is
+// named after its parents, "screen/water".
+//
+// The queries of a frame are only read FRAMES frames later, when the GPU
+// is long done with them, so reading never stalls. The CPU times are held
+// back just as long, so both halves of a result belong to the same frame.
+// The last HISTORY frames of results are kept for the overlay and dump().
+// Every scope also goes to the TraceRecorder, under its own name.
+class PassTimer
+{
+public:
+	enum { FRAMES = 3, HISTORY = 600 };
+
+	struct Timing
+	{
+		std::string name;
+		int depth;			// 0 for a scope not inside another
+		double cpuMs;
+		double gpuMs;
+	};
+
+	// times the enclosing block
+	class Scope
+	{
+	public:
+		Scope(PassTimer& timer, const char* name):
+			timer(timer)
+		{
+			this->timer.begin(name);
+		}
+		~Scope()
+		{
+			this->timer.end();
+		}
+	private:
+		PassTimer& timer;
+	};
+
+	~PassTimer()
+	{
+		for (int f = 0; f < FRAMES; ++f)
+			for (size_t i = 0; i < this->frames[f].passes.size(); ++i)
+				glDeleteQueries(2, this->frames[f].passes[i].queries);
+	}
+
+	// collect the frame FRAMES frames back into results, then start a new one
+	void beginFrame()
+	{
+		this->frame = (this->frame + 1) % FRAMES;
+		Frame& frame = this->frames[this->frame];
+
+		this->results.clear();
+		for (int i = 0; i < frame.count; ++i)
+		{
+			Pass& pass = frame.passes[i];
+			GLuint64 begin = 0, end = 0;
+			glGetQueryObjectui64v(pass.queries[0], GL_QUERY_RESULT, &begin);
+			glGetQueryObjectui64v(pass.queries[1], GL_QUERY_RESULT, &end);
+
+			Timing timing;
+			timing.name = pass.name;
+			timing.depth = pass.depth;
+			timing.cpuMs = pass.cpuMs;
+			timing.gpuMs = (end - begin) / 1000000.0;
+			this->results.push_back(timing);
+		}
+		frame.count = 0;
+		// a scope left open last frame is dropped with it
+		this->open.clear();
+
+		if (!this->results.empty())
+		{
+			if (this->history.size() < HISTORY)
+				this->history.push_back(this->results);
+			else
+				this->history[this->historyNext] = this->results;
+			this->historyNext = (this->historyNext + 1) % HISTORY;
+		}
+	}
+
+	void begin(const char* name)
+	{
+		Frame& frame = this->frames[this->frame];
+		if (frame.count == (int)frame.passes.size())
+		{
+			frame.passes.push_back(Pass());
+			glGenQueries(2, frame.passes.back().queries);
+		}
+		Pass& pass = frame.passes[frame.count];
+		pass.depth = (int)this->open.size();
+		if (this->open.empty())
+			pass.name = name;
+		else
+			pass.name = frame.passes[this->open.back()].name + "/" + name;
+		this->open.push_back(frame.count++);
+
+		pass.start = Clock::now();
+		pass.traceStart = TraceRecorder::shared().now();
+		glQueryCounter(pass.queries[0], GL_TIMESTAMP);
+	}
+
+	// ends the scope begin() started last
+	void end()
+	{
+		Frame& frame = this->frames[this->frame];
+		Pass& pass = frame.passes[this->open.back()];
+		this->open.pop_back();
+		glQueryCounter(pass.queries[1], GL_TIMESTAMP);
+		pass.cpuMs = std::chrono::duration<double, std::milli>(Clock::now() - pass.start).count();
+
+		TraceRecorder& trace = TraceRecorder::shared();
+		size_t slash = pass.name.rfind('/');
+		trace.record("pass", pass.name.c_str() + (slash == std::string::npos ? 0 : slash + 1),
+			pass.traceStart, trace.now());
+	}
+
+	// mean of every scope over the last frames frames of the history, in
+	// the order the scopes first ran
+	void average(int frames, std::vector<Timing>& out) const
+	{
+		out.clear();
+		std::vector<int> counts;
+		int count = (int)this->history.size() < frames ? (int)this->history.size() : frames;
+		for (int f = count; f >= 1; --f)
+		{
+			const std::vector<Timing>& timings = this->historyAt(f);
+			for (size_t i = 0; i < timings.size(); ++i)
+			{
+				size_t j = 0;
+				while (j < out.size() && out[j].name != timings[i].name)
+					++j;
+				if (j == out.size())
+				{
+					out.push_back(timings[i]);
+					counts.push_back(1);
+					continue;
+				}
+				out[j].cpuMs += timings[i].cpuMs;
+				out[j].gpuMs += timings[i].gpuMs;
+				++counts[j];
+			}
+		}
+		for (size_t j = 0; j < out.size(); ++j)
+		{
+			out[j].cpuMs /= counts[j];
+			out[j].gpuMs /= counts[j];
+		}
+	}
+
+	// write the history, oldest frame first, as CSV
+	bool dump(const char* path) const
+	{
+		FILE* file = fopen(path, "w");
+		if (!file)
+			return false;
+		fprintf(file, "frame,scope,depth,cpu_ms,gpu_ms\n");
+		int count = (int)this->history.size();
+		for (int f = count; f >= 1; --f)
+		{
+			const std::vector<Timing>& timings = this->historyAt(f);
+			for (size_t i = 0; i < timings.size(); ++i)
+				fprintf(file, "%d,%s,%d,%.4f,%.4f\n", count - f, timings[i].name.c_str(),
+						timings[i].depth, timings[i].cpuMs, timings[i].gpuMs);
+		}
+		return fclose(file) == 0;
+	}
+
+	// scopes of the frame FRAMES frames before the current one, in the
+	// order they began
+	std::vector<Timing> results;
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Pass
+	{
+		std::string name;
+		int depth = 0;
+		GLuint queries[2];
+		Clock::time_point start;
+		int64_t traceStart = 0;
+		double cpuMs = 0.0;
+	};
+
+	struct Frame
+	{
+		std::vector<Pass> passes;
+		int count = 0;
+	};
+
+	// results of the frame back frames back in the history, 1 = latest
+	const std::vector<Timing>& historyAt(int back) const
+	{
+		int size = (int)this->history.size();
+		return this->history[((int)this->historyNext - back + 2 * size) % size];
+	}
+
+	Frame frames[FRAMES];
+	int frame = 0;
+	std::vector<int> open;			// indices of the scopes begun, not ended
+
+	std::vector<std::vector<Timing>> history;
+	size_t historyNext = 0;
+};
@@ -0,0 +1,204 @@
+#pragma once
+// On-disk cache of linked shader programs (*.glpb)
+//
+// Compiling and linking every program on each launch is most of the
+// startup time. The driver can hand back a linked program as a binary
+// (glGetProgramBinary) and take it again later (glProgramBinary), so a
+// warm start only loads binaries.
+//
+// A binary only fits the driver that made it, so the key hashes the
+// sources of every stage together with GL_VENDOR, GL_RENDERER, GL_VERSION
+// and the GLSL version. A changed shader or an updated driver gives a new
+// key and the stale file is never read again. The driver may still refuse
+// a binary it made itself; load() reports a miss then and the program is
+// compiled as usual.
+//
+//   ProgramCacheHeader
+//   binary			length bytes in the driver's format
+//
+// Files live in directory, named after the key in hex.
+
+#include <glad/glad.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+	#include <direct.h>
+#else
+	#include <sys/stat.h>
+#endif
+
+#define GLPB_VERSION 2	// 2: compileMs counts only the driver time
+
+struct ProgramCacheHeader
+{
+	char magic[4];				// "GLPB"
+	uint32_t version;
+	uint64_t key;
+	uint32_t format;			// binaryFormat of glProgramBinary
+	uint32_t length;			// bytes of the binary
+	float compileMs;			// what the driver took to compile and link on the miss
+	uint32_t reserved;
+};
+
+class ProgramCache
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+	// stage and source of each shader in a program
+	typedef std::vector<std::pair<GLenum, std::string>> Sources;
+
+	// the cache every Shader uses
+	static ProgramCache& shared()
+	{
+		static ProgramCache cache;
+		return cache;
+	}
+
+	// the driver can save and load program binaries, and caching is on
+	bool available()
+	{
+		if (!this->enabled || !(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary))
+			return false;
+		GLint formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+		return formats > 0;
+	}
+
+	uint64_t key(const Sources& sources)
+	{
+		if (this->driver.empty())
+		{
+			const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION, GL_SHADING_LANGUAGE_VERSION };
+			for (GLenum name : strings)
+			{
+				const char* value = (const char*)glGetString(name);
+				this->driver += value ? value : "";
+				this->driver += '\n';
+			}
+		}
+
+		uint64_t hash = fnv1a(14695981039346656037ull, this->driver.data(), this->driver.size());
+		for (size_t i = 0; i < sources.size(); ++i)
+		{
+			uint32_t stage = sources[i].first;
+			hash = fnv1a(hash, &stage, sizeof(stage));
+			hash = fnv1a(hash, sources[i].second.data(), sources[i].second.size());
+		}
+		return hash;
+	}
+
+	// a linked program made from the cached binary, 0 on a miss; compileMs
+	// is what building it took when it was stored
+	GLuint load(uint64_t key, float& compileMs)
+	{
+		FILE* file = fopen(this->path(key).c_str(), "rb");
+		if (!file)
+			return 0;
+
+		ProgramCacheHeader header;
+		std::vector<char> binary;
+		bool ok = fread(&header, sizeof(header), 1, file) == 1
+			&& memcmp(header.magic, "GLPB", 4) == 0
+			&& header.version == GLPB_VERSION
+			&& header.key == key;
+		if (ok)
+		{
+			binary.resize(header.length);
+			ok = header.length > 0 && fread(&binary[0], 1, binary.size(), file) == binary.size();
+		}
+		fclose(file);
+		if (!ok)
+			return 0;
+
+		GLuint program = glCreateProgram();
+		glProgramBinary(program, header.format, &binary[0], (GLsizei)binary.size());
+		GLint success = GL_FALSE;
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (!success)
+		{
+			glDeleteProgram(program);
+			return 0;
+		}
+		compileMs = header.compileMs;
+		return program;
+	}
+
+	// call before linking a program that will be stored
+	void prepare(GLuint program)
+	{
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
+	// save a linked program, false if the driver or the disk would not
+	bool store(uint64_t key, GLuint program, float compileMs)
+	{
+		GLint length = 0;
+		glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+		if (length <= 0)
+			return false;
+
+		std::vector<char> binary(length);
+		GLenum format = 0;
+		glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+		ProgramCacheHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, "GLPB", 4);
+		header.version = GLPB_VERSION;
+		header.key = key;
+		header.format = format;
+		header.length = (uint32_t)length;
+		header.compileMs = compileMs;
+
+#ifdef _WIN32
+		_mkdir(this->directory.c_str());
+#else
+		mkdir(this->directory.c_str(), 0755);
+#endif
+		FILE* file = fopen(this->path(key).c_str(), "wb");
+		if (!file)
+			return false;
+		bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+			&& fwrite(&binary[0], 1, length, file) == (size_t)length;
+		// a short file fails the length check in load() and is rebuilt
+		return fclose(file) == 0 && ok;
+	}
+
+	std::string path(uint64_t key) const
+	{
+		char name[32];
+		snprintf(name, sizeof(name), "/%016llx.glpb", (unsigned long long)key);
+		return this->directory + name;
+	}
+
+	std::string directory = "shader_cache";
+	bool enabled = true;
+
+	// over every program so far
+	unsigned int hits = 0;
+	unsigned int misses = 0;
+	double savedMs = 0.0;		// compile time skipped minus time loading
+
+private:
+	static uint64_t fnv1a(uint64_t hash, const void* data, size_t bytes)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < bytes; ++i)
+		{
+			hash ^= p[i];
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	std::string driver;			// strings of the driver, hashed into every key
+};
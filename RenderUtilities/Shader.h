@@ -2,13 +2,21 @@
 #define SHADER_H
 
 #include <glad/glad.h>
+#include <glm/glm.hpp>
 
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <unordered_map>
 #include <vector>
 
+#include "ProgramCache.h"
+#include "../Utilities/TraceRecorder.H"
 
 
 class Shader
@@ -22,65 +30,347 @@ public:
 		TESS_EVALUATION_SHADER = (1 << 2),
 		GEOMETRY_SHADER = (1 << 3),
 		FRAGMENT_SHADER = (1 << 4),
+		COMPUTE_SHADER = (1 << 5),
 	};
 	//DEFINE_ENUM_FLAG_OPERATORS(Type);
 
 	Type type = NULL_SHADER;
-	// Constructor generates the shader on the fly
-	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag)
+	// Constructor generates the shader on the fly, or loads the program
+	// from the ProgramCache when these sources were linked before.
+	//
+	// A deferred shader only hands the compile and link to the driver and
+	// returns; the status checks, which wait for the driver, are left to
+	// finish(), called by the first Use() or uniform lookup. Start several
+	// before using any and the driver can build them side by side, see
+	// ShaderManager.
+	//
+	// The sources may #include "file" (relative to the including file,
+	// each file once per stage); defines, "#define NAME VALUE" lines, go
+	// in right after the #version line of every stage.
+	Shader(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag,
+		bool deferred = false, const std::string& defines = std::string())
+	{
+		const GLchar* paths[] = { vert, tesc, tese, geom, frag, nullptr };
+		this->build(paths, deferred, defines);
+	}
+	// a compute program, built, cached and deferred like the others
+	explicit Shader(const GLchar* comp, bool deferred = false, const std::string& defines = std::string())
+	{
+		const GLchar* paths[] = { nullptr, nullptr, nullptr, nullptr, nullptr, comp };
+		this->build(paths, deferred, defines);
+	}
+	// the uniform table points into the shader's own names
+	Shader(const Shader&) = delete;
+	Shader& operator=(const Shader&) = delete;
+
+	// wait for the driver to compile and link, print the errors, and store
+	// the program in the cache; does nothing once done
+	void finish()
 	{
-		std::vector<GLuint> shaders;
-		if (vert)
+		if (!this->building)
+			return;
+		this->building = false;
+		TraceRecorder::Scope trace("shader", "finish");
+
+		// the status queries block until the driver is done
+		ProgramCache::Clock::time_point waiting = ProgramCache::Clock::now();
+		for (size_t i = 0; i < this->stages.size(); ++i)
+			this->checkShader(this->stages[i].first, this->stages[i].second, this->stageFiles[i]);
+
+		GLint success;
+		GLchar infoLog[512];
+		// Print linking errors if any
+		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
+		this->driverMs += std::chrono::duration<float, std::milli>(ProgramCache::Clock::now() - waiting).count();
+		if (!success)
 		{
-			shaders.push_back(this->compileShader(GL_VERTEX_SHADER, this->readCode(vert).c_str()));
-			this->type = (Shader::Type)(this->type | Type::VERTEX_SHADER);
+			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
+			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
 		}
-		if (tesc)
+
+		for (size_t i = 0; i < this->stages.size(); ++i)
+			glDeleteShader(this->stages[i].first);
+		this->stages.clear();
+
+		if (this->cached)
 		{
-			shaders.push_back(this->compileShader(GL_TESS_CONTROL_SHADER, this->readCode(tesc).c_str()));
-			this->type = (Shader::Type)(this->type | Type::TESS_CONTROL_SHADER);
+			// only the time the driver held this thread, so the work
+			// that overlaps a deferred shader is not counted as saved
+			ProgramCache& cache = ProgramCache::shared();
+			++cache.misses;
+			std::cout << "SHADER::CACHE::MISS " << this->fileName << " compiled in " << this->driverMs << " ms" << std::endl;
+			// a program that failed to link is built again next time
+			if (success && !cache.store(this->key, this->Program, this->driverMs))
+				std::cout << "ERROR::SHADER::CACHE::CANNOT_WRITE " << cache.path(this->key) << std::endl;
 		}
-		if (tese)
+
+		this->reflectUniforms();
+	}
+
+	// finish() would not wait. Asking needs GL_KHR_parallel_shader_compile,
+	// without it this stays false until finish()
+	bool ready()
+	{
+		if (!this->building)
+			return true;
+#ifdef GL_KHR_parallel_shader_compile
+		if (GLAD_GL_KHR_parallel_shader_compile)
 		{
-			shaders.push_back(this->compileShader(GL_TESS_EVALUATION_SHADER, this->readCode(tese).c_str()));
-			this->type = (Shader::Type)(this->type | Type::TESS_EVALUATION_SHADER);
+			GLint done = GL_FALSE;
+			glGetProgramiv(this->Program, GL_COMPLETION_STATUS_KHR, &done);
+			return done == GL_TRUE;
 		}
-		if (geom)
+#endif
+		return false;
+	}
+
+	// Uses the current shader
+	void Use()
+	{
+		this->finish();
+		glUseProgram(this->Program);
+	}
+
+	// Typed uniform setters for the program in use. The location comes from
+	// the table built at link time and the upload is skipped when the
+	// uniform already holds the value. Names of uniforms the linker dropped
+	// are ignored, like glUniform with location -1.
+	void setInt(const char* name, GLint value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value, sizeof(value)))
+			glUniform1i(uniform->location, value);
+	}
+	void setFloat(const char* name, GLfloat value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value, sizeof(value)))
+			glUniform1f(uniform->location, value);
+	}
+	void setVec2(const char* name, const glm::vec2& value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value[0], sizeof(value)))
+			glUniform2fv(uniform->location, 1, &value[0]);
+	}
+	void setIVec2(const char* name, const glm::ivec2& value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value[0], sizeof(value)))
+			glUniform2iv(uniform->location, 1, &value[0]);
+	}
+	void setVec3(const char* name, const glm::vec3& value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value[0], sizeof(value)))
+			glUniform3fv(uniform->location, 1, &value[0]);
+	}
+	void setVec4(const char* name, const glm::vec4& value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value[0], sizeof(value)))
+			glUniform4fv(uniform->location, 1, &value[0]);
+	}
+	void setMat4(const char* name, const glm::mat4& value)
+	{
+		Uniform* uniform = this->find(name);
+		if (this->changed(uniform, &value[0][0], sizeof(value)))
+			glUniformMatrix4fv(uniform->location, 1, GL_FALSE, &value[0][0]);
+	}
+
+	// location of an active uniform, -1 if there is none
+	GLint location(const char* name)
+	{
+		Uniform* uniform = this->find(name);
+		return uniform ? uniform->location : -1;
+	}
+
+	// how often uniforms were looked up, uploaded, and skipped because
+	// they already held the value
+	struct Stats
+	{
+		unsigned long lookups = 0;
+		unsigned long uploads = 0;
+		unsigned long skipped = 0;
+	};
+	Stats stats;
+	// summed over every shader
+	static Stats& totalStats()
+	{
+		static Stats totals;
+		return totals;
+	}
+private:
+	// one active uniform and the last value uploaded to it
+	struct Uniform
+	{
+		GLint location;
+		GLenum type;
+		GLint size;
+		bool uploaded;
+		unsigned char value[sizeof(glm::mat4)];
+	};
+
+	// build the name -> uniform table from the linked program
+	void reflectUniforms()
+	{
+		GLint count = 0;
+		GLint max_length = 0;
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(this->Program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+		// by_name points into names, which must not reallocate
+		this->names.reserve(count);
+		std::vector<GLchar> name(max_length + 1);
+		for (GLint i = 0; i < count; ++i)
 		{
-			shaders.push_back(this->compileShader(GL_GEOMETRY_SHADER, this->readCode(geom).c_str()));
-			this->type = (Shader::Type)(this->type | Type::GEOMETRY_SHADER);
+			Uniform uniform;
+			GLsizei length = 0;
+			glGetActiveUniform(this->Program, i, (GLsizei)name.size(), &length, &uniform.size, &uniform.type, &name[0]);
+			std::string key(&name[0], length);
+			uniform.location = glGetUniformLocation(this->Program, key.c_str());
+			// block members have no location of their own
+			if (uniform.location < 0)
+				continue;
+			uniform.uploaded = false;
+
+			// arrays are reported as "name[0]", accept the bare name too
+			if (key.size() > 3 && key.compare(key.size() - 3, 3, "[0]") == 0)
+				key.erase(key.size() - 3);
+			this->names.push_back(key);
+			this->by_name[this->names.back().c_str()] = (int)this->uniforms.size();
+			this->uniforms.push_back(uniform);
 		}
-		if (frag)
+	}
+
+	// the table is keyed on the characters of the name, so a name built in
+	// a reused buffer finds its own uniform, without a std::string per call
+	Uniform* find(const char* name)
+	{
+		this->finish();
+		++this->stats.lookups;
+		++totalStats().lookups;
+
+		NameTable::iterator found = this->by_name.find(name);
+		return found == this->by_name.end() ? nullptr : &this->uniforms[found->second];
+	}
+
+	// FNV-1a over the characters, and equality by strcmp
+	struct NameHash
+	{
+		size_t operator()(const char* name) const
 		{
-			shaders.push_back(this->compileShader(GL_FRAGMENT_SHADER, this->readCode(frag).c_str()));
-			this->type = (Shader::Type)(this->type | Type::FRAGMENT_SHADER);
+			uint32_t hash = 2166136261u;
+			for (; *name; ++name)
+				hash = (hash ^ (unsigned char)*name) * 16777619u;
+			return hash;
 		}
-		// Shader Program
-		GLint success;
-		GLchar infoLog[512];
-		this->Program = glCreateProgram();
+	};
+	struct NameEqual
+	{
+		bool operator()(const char* a, const char* b) const { return strcmp(a, b) == 0; }
+	};
+	typedef std::unordered_map<const char*, int, NameHash, NameEqual> NameTable;
 
-		for (GLuint shader : shaders)
-			glAttachShader(this->Program, shader);
+	// remember value and say whether it needs uploading
+	bool changed(Uniform* uniform, const void* value, size_t bytes)
+	{
+		if (!uniform)
+			return false;
+		if (uniform->uploaded && memcmp(uniform->value, value, bytes) == 0)
+		{
+			++this->stats.skipped;
+			++totalStats().skipped;
+			return false;
+		}
+		memcpy(uniform->value, value, bytes);
+		uniform->uploaded = true;
+		++this->stats.uploads;
+		++totalStats().uploads;
+		return true;
+	}
 
-		glLinkProgram(this->Program);
-		// Print linking errors if any
-		glGetProgramiv(this->Program, GL_LINK_STATUS, &success);
-		if (!success)
+	std::vector<Uniform> uniforms;
+	std::vector<std::string> names;		// the keys of by_name
+	NameTable by_name;
+
+	std::string fileName;							// for the log and the trace
+	std::vector<std::pair<GLuint, GLenum>> stages;	// compiling, checked by finish()
+	std::vector<std::string> stageFiles;			// the files of each stage, for errors
+	bool building = false;							// finish() still has to run
+	bool cached = false;							// the ProgramCache is in use
+	uint64_t key = 0;
+	ProgramCache::Clock::time_point started;
+	float driverMs = 0.0f;							// spent submitting and waiting for the driver
+
+	// the shader in the trace, its file name without the directory
+	std::string traceName(const char* path)
+	{
+		const char* slash = strrchr(path, '/');
+		const char* backslash = strrchr(path, '\\');
+		if (backslash > slash)
+			slash = backslash;
+		return slash ? slash + 1 : path;
+	}
+	// the code of path with its #include lines replaced by the files they
+	// name, and defines after #version. #line directives keep the line
+	// numbers of errors right, the source string number is the index of
+	// the file in files
+	std::string preprocess(const GLchar* path, const std::string& defines, std::vector<std::string>& files)
+	{
+		std::string code = this->expand(path, files);
+		size_t version = code.find("#version");
+		if (version != std::string::npos && !defines.empty())
 		{
-			glGetProgramInfoLog(this->Program, 512, NULL, infoLog);
-			std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+			size_t line = code.find('\n', version);
+			line = line == std::string::npos ? code.size() : line + 1;
+			code.insert(line, defines + "#line 2 0\n");
 		}
+		return code;
+	}
+	std::string expand(const std::string& path, std::vector<std::string>& files)
+	{
+		int source = (int)files.size();
+		files.push_back(path);
+		std::istringstream lines(this->readCode(path.c_str()));
+		std::string out, line;
+		for (int number = 1; std::getline(lines, line); ++number)
+		{
+			size_t start = line.find_first_not_of(" \t");
+			if (start == std::string::npos || line.compare(start, 8, "#include") != 0)
+			{
+				out += line + "\n";
+				continue;
+			}
 
-		for (GLuint shader : shaders)
-			glDeleteShader(shader);
+			size_t open = line.find('"', start);
+			size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+			if (close == std::string::npos)
+			{
+				std::cout << "ERROR::SHADER::BAD_INCLUDE " << path << ":" << number << std::endl;
+				out += "\n";
+				continue;
+			}
+			size_t slash = path.find_last_of("/\\");
+			std::string file = (slash == std::string::npos ? std::string() : path.substr(0, slash + 1))
+				+ line.substr(open + 1, close - open - 1);
+
+			if (std::find(files.begin(), files.end(), file) == files.end())
+			{
+				out += "#line 1 " + std::to_string(files.size()) + "\n";
+				out += this->expand(file, files);
+			}
+			out += "#line " + std::to_string(number + 1) + " " + std::to_string(source) + "\n";
+		}
+		return out;
 	}
-	// Uses the current shader
-	void Use()
+	std::string sourceList(const std::vector<std::string>& files)
 	{
-		glUseProgram(this->Program);
+		std::string list;
+		for (size_t i = 0; i < files.size(); ++i)
+			list += (i ? ", " : "") + std::to_string(i) + " " + this->traceName(files[i].c_str());
+		return list;
 	}
-private:
 	std::string readCode(const GLchar* path)
 	{
 		std::string code;
@@ -107,15 +397,86 @@ private:
 		}
 		return code;
 	}
+	// paths of the vertex, tessellation control and evaluation, geometry,
+	// fragment and compute stages, null for the ones left out
+	void build(const GLchar* const paths[6], bool deferred, const std::string& defines)
+	{
+		this->fileName = this->traceName(paths[5] ? paths[5] : paths[4] ? paths[4] : paths[0]);
+		TraceRecorder::Scope trace("shader", this->fileName.c_str());
+
+		// read every stage first, the sources are the cache key
+		const GLenum stages[] = { GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER,
+			GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER };
+		const Type types[] = { VERTEX_SHADER, TESS_CONTROL_SHADER, TESS_EVALUATION_SHADER,
+			GEOMETRY_SHADER, FRAGMENT_SHADER, COMPUTE_SHADER };
+		ProgramCache::Sources sources;
+		for (int i = 0; i < 6; ++i)
+		{
+			if (!paths[i])
+				continue;
+			std::vector<std::string> files;
+			sources.push_back(std::make_pair(stages[i], this->preprocess(paths[i], defines, files)));
+			this->stageFiles.push_back(this->sourceList(files));
+			this->type = (Shader::Type)(this->type | types[i]);
+		}
+
+		ProgramCache& cache = ProgramCache::shared();
+		this->cached = cache.available();
+		this->key = this->cached ? cache.key(sources) : 0;
+		this->started = ProgramCache::Clock::now();
+
+		float compileMs = 0.0f;
+		this->Program = this->cached ? cache.load(this->key, compileMs) : 0;
+		if (this->Program)
+		{
+			double loadMs = std::chrono::duration<double, std::milli>(ProgramCache::Clock::now() - this->started).count();
+			++cache.hits;
+			cache.savedMs += compileMs - loadMs;
+			std::cout << "SHADER::CACHE::HIT " << this->fileName << " loaded in " << loadMs
+				<< " ms, saved " << compileMs - loadMs << " ms" << std::endl;
+			this->reflectUniforms();
+			return;
+		}
+
+		ProgramCache::Clock::time_point submitting = ProgramCache::Clock::now();
+		for (size_t i = 0; i < sources.size(); ++i)
+			this->stages.push_back(std::make_pair(
+				this->compileShader(sources[i].first, sources[i].second.c_str()), sources[i].first));
+
+		// Shader Program
+		this->Program = glCreateProgram();
+		if (this->cached)
+			cache.prepare(this->Program);
+
+		for (size_t i = 0; i < this->stages.size(); ++i)
+			glAttachShader(this->Program, this->stages[i].first);
+
+		{
+			TraceRecorder::Scope linking("shader", "link");
+			glLinkProgram(this->Program);
+		}
+		this->driverMs = std::chrono::duration<float, std::milli>(ProgramCache::Clock::now() - submitting).count();
+		this->building = true;
+
+		if (!deferred)
+			this->finish();
+	}
+
+	// hand one stage to the driver, checkShader() reads the result
 	GLuint compileShader(GLenum shader_type, const char* code)
 	{
 		GLuint shader_number;
-		GLint success;
-		GLchar infoLog[512];
 		// Vertex Shader
+		TraceRecorder::Scope trace("shader", "compile");
 		shader_number = glCreateShader(shader_type);
 		glShaderSource(shader_number, 1, &code, NULL);
 		glCompileShader(shader_number);
+		return shader_number;
+	}
+	void checkShader(GLuint shader_number, GLenum shader_type, const std::string& files)
+	{
+		GLint success;
+		GLchar infoLog[512];
 		// Print compile errors if any
 		glGetShaderiv(shader_number, GL_COMPILE_STATUS, &success);
 		if (!success)
@@ -131,8 +492,11 @@ private:
 				std::cout << "ERROR::SHADER::GEOMETRY::COMPILATION_FAILED\n" << infoLog << std::endl;
 			else if (shader_type == GL_FRAGMENT_SHADER)
 				std::cout << "ERROR::SHADER::FRAGMENT::COMPILATION_FAILED\n" << infoLog << std::endl;
+			else if (shader_type == GL_COMPUTE_SHADER)
+				std::cout << "ERROR::SHADER::COMPUTE::COMPILATION_FAILED\n" << infoLog << std::endl;
+			// the errors name a line and a source string, these are the strings
+			std::cout << "sources: " << files << std::endl;
 		}
-		return shader_number;
 	}
 };
 
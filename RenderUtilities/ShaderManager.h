@@ -0,0 +1,82 @@
+#pragma once
+#include <glad/glad.h>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Shader.h"
+
+// Starts every program of the scene at once instead of one after another.
+//
+// submit() makes a deferred Shader: its stages are compiled and linked
+// without asking the driver how it went, so nothing waits on the driver
+// here. With GL_KHR_parallel_shader_compile the driver builds them on
+// threads of its own while the caller goes on decoding and uploading
+// textures; without it the driver still builds them in the background as
+// far as it can. A shader is waited for the first time it is used, or in
+// finishAll().
+class ShaderManager
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	ShaderManager()
+	{
+#ifdef GL_KHR_parallel_shader_compile
+		this->parallel = GLAD_GL_KHR_parallel_shader_compile != 0;
+		// as many compiler threads as the driver likes
+		if (this->parallel)
+			glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+#endif
+	}
+
+	// the manager does not own the shaders, like the new Shader it replaces
+	Shader* submit(const GLchar* vert, const GLchar* tesc, const GLchar* tese, const char* geom, const char* frag,
+		const std::string& defines = std::string())
+	{
+		Shader* shader = new Shader(vert, tesc, tese, geom, frag, true, defines);
+		this->shaders.push_back(shader);
+		return shader;
+	}
+	Shader* submitCompute(const GLchar* comp, const std::string& defines = std::string())
+	{
+		Shader* shader = new Shader(comp, true, defines);
+		this->shaders.push_back(shader);
+		return shader;
+	}
+
+	// shaders still building, without waiting; with no parallel compile
+	// that is every one not used yet
+	int pending()
+	{
+		int count = 0;
+		for (size_t i = 0; i < this->shaders.size(); ++i)
+			if (!this->shaders[i]->ready())
+				++count;
+		return count;
+	}
+
+	// wait for every shader and print their errors
+	void finishAll()
+	{
+		Clock::time_point start = Clock::now();
+		for (size_t i = 0; i < this->shaders.size(); ++i)
+			this->shaders[i]->finish();
+		this->waitMs += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	}
+
+	void report(std::ostream& out) const
+	{
+		out << "SHADERS::SUBMITTED " << this->shaders.size() << " programs, "
+			<< (this->parallel ? "parallel" : "serial") << " compile, waited "
+			<< this->waitMs << " ms" << std::endl;
+	}
+
+	bool parallel = false;		// GL_KHR_parallel_shader_compile is in use
+
+private:
+	std::vector<Shader*> shaders;
+	double waitMs = 0.0;		// inside finishAll()
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <map>
+#include <string>
+
+#include "ShaderManager.h"
+
+// What a water program is specialized for. Each combination is a program
+// of its own, built with the flags as #defines (see
+// shaders/include/features.glsl), so the shaders never branch on them.
+struct WaterFeatures
+{
+	// values of the WAVE_MODEL define, the same as the wave browser
+	enum WaveModel { WAVE_SINE = 1, WAVE_HEIGHTMAP = 2, WAVE_RIPPLES = 3, WAVE_OCEAN = 4 };
+	// what the water mirrors: the sky box, or the reflection target
+	enum Reflection { REFLECTION_SKYBOX = 0, REFLECTION_PLANAR = 1 };
+	// how far refracted rays are followed into the pool
+	enum Quality { QUALITY_LOW = 0, QUALITY_MEDIUM = 1, QUALITY_HIGH = 2, QUALITY_COUNT };
+
+	int waveModel = WAVE_HEIGHTMAP;
+	bool drops = false;			// sum the drops block in the vertex shader
+	int reflection = REFLECTION_SKYBOX;
+	int quality = QUALITY_HIGH;
+	bool normalMap = false;		// normals from a slope texture, not the pixel derivatives
+
+	// the sine waves have no drops or slope texture, so those variants
+	// are the same
+	WaterFeatures normalized() const
+	{
+		WaterFeatures features = *this;
+		if (features.waveModel == WAVE_SINE)
+		{
+			features.drops = false;
+			features.normalMap = false;
+		}
+		return features;
+	}
+
+	unsigned int key() const
+	{
+		return this->waveModel | (this->drops ? 1 : 0) << 3 | this->reflection << 4 | this->quality << 5
+			| (this->normalMap ? 1 : 0) << 7;
+	}
+
+	std::string defines() const
+	{
+		return "#define WAVE_MODEL " + std::to_string(this->waveModel) + "\n"
+			+ "#define DROPS " + (this->drops ? "1" : "0") + "\n"
+			+ "#define REFLECTION " + std::to_string(this->reflection) + "\n"
+			+ "#define QUALITY " + std::to_string(this->quality) + "\n"
+			+ "#define NORMAL_MAP " + (this->normalMap ? "1" : "0") + "\n";
+	}
+};
+
+// The water programs, one per WaterFeatures, built the first time they
+// are asked for. prepare() starts the ones the first frames need through
+// the ShaderManager, so they compile with everything else; the rest come
+// from the ProgramCache after the first run.
+class ShaderVariants
+{
+public:
+	// directory holds cubemaps.* (the sine waves) and heightMap.* (the
+	// rest); manager may be null, then prepare() builds right away
+	ShaderVariants(const std::string& directory, ShaderManager* manager):
+		directory(directory), manager(manager)
+	{
+	}
+
+	// the program for features, compiled now if it is new
+	Shader* get(const WaterFeatures& features)
+	{
+		WaterFeatures normalized = features.normalized();
+		std::map<unsigned int, Shader*>::iterator found = this->variants.find(normalized.key());
+		if (found != this->variants.end())
+			return found->second;
+		return this->variants[normalized.key()] = this->build(normalized, false);
+	}
+
+	// start building features without waiting for it
+	void prepare(const WaterFeatures& features)
+	{
+		WaterFeatures normalized = features.normalized();
+		if (!this->variants.count(normalized.key()))
+			this->variants[normalized.key()] = this->build(normalized, true);
+	}
+
+	size_t size() const { return this->variants.size(); }
+
+private:
+	Shader* build(const WaterFeatures& features, bool deferred)
+	{
+		std::string name = this->directory
+			+ (features.waveModel == WaterFeatures::WAVE_SINE ? "/cubemaps" : "/heightMap");
+		std::string vert = name + ".vert", frag = name + ".frag";
+		if (deferred && this->manager)
+			return this->manager->submit(vert.c_str(), nullptr, nullptr, nullptr, frag.c_str(), features.defines());
+		return new Shader(vert.c_str(), nullptr, nullptr, nullptr, frag.c_str(), false, features.defines());
+	}
+
+	std::string directory;
+	ShaderManager* manager;
+	std::map<unsigned int, Shader*> variants;	// by WaterFeatures::key()
+};
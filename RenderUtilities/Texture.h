@@ -1,5 +1,5 @@
 #pragma once
-#include <opencv2\opencv.hpp>
+#include <opencv2/opencv.hpp>
 #include <opencv2/imgcodecs.hpp>
 #include <glad/glad.h>
 #include <glm/glm.hpp>
@@ -18,12 +18,14 @@ public:
 	Type type;
 
 	Texture2D(const char* path, Type texture_type = Texture2D::TEXTURE_DEFAULT):
+		//cv::imread(path, cv::IMREAD_COLOR).convertTo(img, CV_32FC3, 1 / 255.0f);	//unsigned char to float
+		Texture2D(cv::imread(path, cv::IMREAD_COLOR), texture_type)
+	{
+	}
+	// upload pixels that were already decoded (see AssetLoader)
+	Texture2D(const cv::Mat& img, Type texture_type = Texture2D::TEXTURE_DEFAULT):
 		type(texture_type)
 	{
-		cv::Mat img;
-		//cv::imread(path, cv::IMREAD_COLOR).convertTo(img, CV_32FC3, 1 / 255.0f);	//unsigned char to float
-		img = cv::imread(path, cv::IMREAD_COLOR);
-
 		this->size.x = img.cols;
 		this->size.y = img.rows;
 
@@ -32,7 +34,6 @@ public:
 		glGenTextures(1, &this->id);
 
 		glBindTexture(GL_TEXTURE_2D, this->id);
-		glGenerateMipmap(GL_TEXTURE_2D);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
@@ -41,9 +42,10 @@ public:
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, img.cols, img.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, img.data);
 		else if (img.type() == CV_8UC4)
 			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, img.cols, img.rows, 0, GL_BGRA, GL_UNSIGNED_BYTE, img.data);
+		// after the upload, on an empty level 0 it is an error
+		if (!img.empty())
+			glGenerateMipmap(GL_TEXTURE_2D);
 		glBindTexture(GL_TEXTURE_2D, 0);
-
-		img.release();
 	}
 	void bind(GLenum bind_unit)
 	{
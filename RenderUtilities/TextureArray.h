@@ -0,0 +1,145 @@
+#pragma once
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// single-channel GL_TEXTURE_2D_ARRAY, one layer per image
+// used for height data, where only one channel is ever read
+class Texture2DArray
+{
+public:
+	// allocate empty storage, filled later with upload()
+	// a 0x0 size defers the allocation to the first uploadImage()
+	Texture2DArray(int width, int height, int layers, GLenum internal_format = GL_R8):
+		layers(layers), internal_format(internal_format)
+	{
+		this->size.x = width;
+		this->size.y = height;
+		if (width > 0 && height > 0)
+			this->allocate();
+	}
+
+	// load every image as one layer, keeping only its red channel
+	// internal_format is GL_R8 or GL_R16
+	Texture2DArray(const std::vector<std::string>& paths, GLenum internal_format = GL_R8):
+		layers((int)paths.size()), internal_format(internal_format)
+	{
+		for (int i = 0; i < this->layers; ++i)
+		{
+			cv::Mat img = cv::imread(paths[i], READ_FLAGS);
+			if (img.empty())
+			{
+				std::cout << "Texture array layer failed to load at path: " << paths[i] << std::endl;
+				continue;
+			}
+			this->uploadImage(i, img);
+		}
+	}
+
+	// how images should be decoded before uploadImage
+	static const int READ_FLAGS = cv::IMREAD_ANYDEPTH | cv::IMREAD_COLOR;
+
+	// upload the red channel of a decoded image into one layer
+	// the storage is allocated from the first image if it doesn't exist yet
+	// keep, when given, gets a copy of the pixels at the layer's place in
+	// every layer packed one after another
+	void uploadImage(int layer, const cv::Mat& img, std::vector<unsigned char>* keep = nullptr)
+	{
+		if (img.empty())
+			return;
+
+		if (this->id == 0)
+		{
+			this->size.x = img.cols;
+			this->size.y = img.rows;
+			this->allocate();
+		}
+
+		cv::Mat red = this->toRed(img);
+		this->upload(layer, red.data);
+
+		if (keep && red.cols == this->size.x && red.rows == this->size.y)
+		{
+			size_t bytes = red.total() * red.elemSize();
+			keep->resize(bytes * this->layers);
+			memcpy(&(*keep)[bytes * layer], red.data, bytes);
+		}
+	}
+
+	// copy tightly packed single-channel pixels into one layer
+	void upload(int layer, const void* pixels)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, this->size.x, this->size.y, 1,
+			GL_RED, this->pixelType(), pixels);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	void setWrap(GLenum wrap)
+	{
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	void bind(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+	}
+	static void unbind(GLenum bind_unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + bind_unit);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+	GLenum pixelType() const
+	{
+		if (this->internal_format == GL_R16)
+			return GL_UNSIGNED_SHORT;
+		if (this->internal_format == GL_R32F)
+			return GL_FLOAT;
+		return GL_UNSIGNED_BYTE;
+	}
+
+	glm::ivec2 size;
+	int layers;
+	GLenum internal_format;
+private:
+	void allocate()
+	{
+		glGenTextures(1, &this->id);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, this->id);
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, this->internal_format, this->size.x, this->size.y, this->layers);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+	}
+
+	// the red channel, as 8 or 16 bits depending on the storage format
+	cv::Mat toRed(const cv::Mat& img) const
+	{
+		cv::Mat red;
+		if (img.channels() == 1)
+			red = img.clone();
+		else
+			cv::extractChannel(img, red, 2);	//opencv keeps BGR
+
+		if (this->internal_format == GL_R16 && red.depth() == CV_8U)
+			red.convertTo(red, CV_16U, 257.0);
+		else if (this->internal_format != GL_R16 && red.depth() == CV_16U)
+			red.convertTo(red, CV_8U, 1.0 / 257.0);
+		return red;
+	}
+
+	GLuint id = 0;
+};
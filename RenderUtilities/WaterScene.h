@@ -0,0 +1,208 @@
+#pragma once
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include "BufferObject.h"
+#include "DropBlock.h"
+#include "GpuWaveSolver.h"
+#include "Shader.h"
+#include "ShaderVariants.h"
+#include "Texture.h"
+#include "TextureArray.h"
+
+// The water scene as TrainView draws it, shared with tools/HeadlessRender
+// so the checksums it prints come from the same draw code and constants.
+
+// cells per side of the water grid; the ripple solver has one per vertex
+static const unsigned int WATER_GRID_RESOLUTION = 200;
+// t_time per simulated second, what the sine waves and drops run on
+static const float WAVE_TIME_RATE = 0.625f;
+// texture units per meter of ocean wave
+static const float OCEAN_HEIGHT_SCALE = 0.25f;
+// side of the water square in world units
+static const float WATER_SIZE = 100.0f;
+
+// a drop of radius as the ripple solvers take it, WaveSolver or GpuWaveSolver
+template <class Solver>
+void addRippleDrop(Solver& solver, glm::vec2 uv, float radius)
+{
+	solver.addDrop(uv.x, uv.y, 0.02f * radius, 0.5f);
+}
+
+// forget the drops that are over at time
+inline void expireDrops(std::vector<Drop>& drops, float time)
+{
+	for (size_t i = 0; i < drops.size(); ++i)
+	{
+		if (time - drops[i].time > drops[i].keepTime)
+		{
+			drops.erase(drops.begin() + i);
+			--i;
+		}
+	}
+}
+
+// send the live drops to the drops block, at most MAX_DROP_AMOUNT of them
+inline void uploadDrops(const UBO& buffer, const std::vector<Drop>& drops)
+{
+	size_t amount = std::min(drops.size(), (size_t)MAX_DROP_AMOUNT);
+
+	DropBlock block;
+	block.amount = (GLint)amount;
+	for (size_t i = 0; i < amount; ++i)
+	{
+		block.drops[i].point = drops[i].point;
+		block.drops[i].time = drops[i].time;
+		block.drops[i].radius = drops[i].radius;
+		block.drops[i].keepTime = drops[i].keepTime;
+	}
+
+	// only the live part of the array is worth sending
+	GLsizeiptr used = offsetof(DropBlock, drops) + amount * sizeof(DropData);
+
+	glBindBuffer(GL_UNIFORM_BUFFER, buffer.ubo);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, used, &block);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// the unit cube as 36 vertices, for the sky box
+inline GLuint createSkyboxVAO(GLuint* vbo_out = nullptr)
+{
+	float vertices[] = {
+		-1.0f,  1.0f, -1.0f,	-1.0f, -1.0f, -1.0f,	 1.0f, -1.0f, -1.0f,
+		 1.0f, -1.0f, -1.0f,	 1.0f,  1.0f, -1.0f,	-1.0f,  1.0f, -1.0f,
+
+		-1.0f, -1.0f,  1.0f,	-1.0f, -1.0f, -1.0f,	-1.0f,  1.0f, -1.0f,
+		-1.0f,  1.0f, -1.0f,	-1.0f,  1.0f,  1.0f,	-1.0f, -1.0f,  1.0f,
+
+		 1.0f, -1.0f, -1.0f,	 1.0f, -1.0f,  1.0f,	 1.0f,  1.0f,  1.0f,
+		 1.0f,  1.0f,  1.0f,	 1.0f,  1.0f, -1.0f,	 1.0f, -1.0f, -1.0f,
+
+		-1.0f, -1.0f,  1.0f,	-1.0f,  1.0f,  1.0f,	 1.0f,  1.0f,  1.0f,
+		 1.0f,  1.0f,  1.0f,	 1.0f, -1.0f,  1.0f,	-1.0f, -1.0f,  1.0f,
+
+		-1.0f,  1.0f, -1.0f,	 1.0f,  1.0f, -1.0f,	 1.0f,  1.0f,  1.0f,
+		 1.0f,  1.0f,  1.0f,	-1.0f,  1.0f,  1.0f,	-1.0f,  1.0f, -1.0f,
+
+		-1.0f, -1.0f, -1.0f,	-1.0f, -1.0f,  1.0f,	 1.0f, -1.0f, -1.0f,
+		 1.0f, -1.0f, -1.0f,	-1.0f, -1.0f,  1.0f,	 1.0f, -1.0f,  1.0f,
+	};
+
+	GLuint vao, vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	glBindVertexArray(0);
+	if (vbo_out)
+		*vbo_out = vbo;
+	return vao;
+}
+
+// the sky box where nothing was drawn yet
+inline void drawSkyBox(Shader& shader, GLuint vao, GLuint cubemap)
+{
+	glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
+	shader.Use();
+	shader.setInt("skybox", 0);
+
+	glBindVertexArray(vao);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap);
+	glDrawArrays(GL_TRIANGLES, 0, 36);
+	glBindVertexArray(0);
+	glDepthFunc(GL_LESS); // set depth function back to default
+}
+
+// what one water draw reads besides its program
+struct WaterInputs
+{
+	glm::vec3 position = glm::vec3(0.0f, 0.0f, 0.0f);	// centre of the water square
+	float amplitude = 0.1f;
+	float wavelength = 0.5f;
+	float moveFactor = 0.0f;				// the sine waves only
+	VAO* grid = nullptr;
+	GLuint cubemap = 0;
+	Texture2D* tiles = nullptr;
+	GLuint reflection = 0;					// with REFLECTION_PLANAR
+	// the heights: a texture array, or the GPU solver's images when the
+	// features ask for its normal map; the sine waves use neither
+	Texture2DArray* heights = nullptr;
+	GpuWaveSolver* gpuSolver = nullptr;
+	int layer = 0;							// heightmap frame to sample
+};
+
+// the water grid with the program of features, blended over what is there;
+// camera, light and time come from the commom_matrices block, the drops
+// from the drops block
+inline void drawWater(Shader& shader, const WaterFeatures& features, const WaterInputs& in)
+{
+	glEnable(GL_BLEND);
+	shader.Use();
+
+	glm::mat4 model_matrix = glm::mat4(1.0f);
+	model_matrix = glm::translate(model_matrix, in.position);
+	model_matrix = glm::scale(model_matrix, glm::vec3(WATER_SIZE, WATER_SIZE, WATER_SIZE));
+
+	shader.setMat4("u_model", model_matrix);
+	shader.setVec3("u_color", glm::vec3(0.0f, 1.0f, 0.0f));
+	shader.setFloat("amplitude", in.amplitude);
+	shader.setFloat("wavelength", in.wavelength);
+
+	// unit 0 holds the sky box cube map, so the heights go on unit 2;
+	// the height bias of each wave model is compiled into its variant
+	if (features.waveModel == WaterFeatures::WAVE_SINE)
+	{
+		shader.setFloat("speed", 1.0f);
+		shader.setFloat("moveFactor", in.moveFactor);
+	}
+	else
+	{
+		if (features.normalMap)
+		{
+			in.gpuSolver->bindHeights(2);
+			in.gpuSolver->bindSlopes(4);
+			shader.setInt("u_slopes", 4);
+		}
+		else
+			in.heights->bind(2);
+		shader.setInt("u_texture", 2);
+		if (features.waveModel == WaterFeatures::WAVE_HEIGHTMAP)
+		{
+			shader.setFloat("u_layer", (float)in.layer);
+			shader.setInt("u_layerCount", in.heights->layers);
+		}
+	}
+
+	in.tiles->bind(1);
+	shader.setInt("tiles", 1);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, in.cubemap);
+	shader.setInt("skybox", 0);
+
+	if (features.reflection == WaterFeatures::REFLECTION_PLANAR)
+	{
+		glActiveTexture(GL_TEXTURE3);
+		glBindTexture(GL_TEXTURE_2D, in.reflection);
+		shader.setInt("reflectionTexture", 3);
+	}
+
+	// every live drop is summed in the vertex shader from the drops
+	// block, unless there are none and the variant leaves the loop out
+	glBindVertexArray(in.grid->vao);
+	glDrawElements(GL_TRIANGLES, in.grid->element_amount, in.grid->element_type, 0);
+	glBindVertexArray(0);
+
+	//unbind shader(switch to fixed pipeline)
+	glUseProgram(0);
+
+	glDisable(GL_BLEND);
+}
@@ -0,0 +1,407 @@
+/************************************************************************
+     File:        TessendorfOcean.cpp
+
+     Comment:
+						Spectral ocean after Tessendorf.
+						See TessendorfOcean.H for the overview.
+
+						Height and dx share one complex transform, dz and
+						the x slope share another, since each of them is the
+						transform of a Hermitian spectrum and so comes out
+						real. Three 2D inverse FFTs give all five fields,
+						one gives the heights alone.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "TessendorfOcean.H"
+
+#include "Utilities/SimdMath.H"
+#include "Utilities/ThreadPool.H"
+
+#include <algorithm>
+#include <math.h>
+#include <random>
+
+static const float GRAVITY = 9.81f;
+static const float PI = 3.14159265f;
+
+// the transpose works on square tiles this wide
+static const int BLOCK = 16;
+
+// below this many samples the threads cost more than they save
+static const int MIN_SAMPLES_FOR_THREADS = 64 * 64;
+
+//************************************************************************
+//
+// * complex multiply without the NaN/inf checks std::complex does
+//========================================================================
+static inline std::complex<float> mul(const std::complex<float>& a, const std::complex<float>& b)
+//========================================================================
+{
+	return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(),
+							   a.real() * b.imag() + a.imag() * b.real());
+}
+
+//************************************************************************
+//
+// * in place iterative radix-2 transform of one row
+//   twiddles hold exp(2 pi i j / n), so this is the inverse (unscaled)
+//========================================================================
+static void transformRow(std::complex<float>* row, int n,
+						 const int* bitReverse, const std::complex<float>* twiddles)
+//========================================================================
+{
+	for (int i = 0; i < n; ++i) {
+		int j = bitReverse[i];
+		if (i < j)
+			std::swap(row[i], row[j]);
+	}
+
+	for (int length = 2; length <= n; length <<= 1) {
+		int half = length >> 1;
+		int step = n / length;
+		for (int start = 0; start < n; start += length) {
+			std::complex<float>* a = row + start;
+			std::complex<float>* b = a + half;
+			for (int k = 0; k < half; ++k) {
+				std::complex<float> t = mul(b[k], twiddles[k * step]);
+				b[k] = a[k] - t;
+				a[k] = a[k] + t;
+			}
+		}
+	}
+}
+
+//************************************************************************
+//
+// * Constructor
+//========================================================================
+TessendorfOcean::
+TessendorfOcean(int _size, float _patchLength, unsigned int _threadCount, unsigned int _seed)
+	: amplitude(0.0081f), fetch(100000.0f), gamma(3.3f), choppiness(1.0f),
+	  size(_size), patchLength(_patchLength), threadCount(_threadCount), seed(_seed),
+	  spectrum(PHILLIPS), windSpeed(10.0f), windDirection(0.0f), fieldCount(3)
+//========================================================================
+{
+	logSize = 0;
+	while ((1 << logSize) < size)
+		++logSize;
+	size = 1 << logSize;
+
+	int n = size;
+	twiddles.resize(n / 2);
+	for (int j = 0; j < n / 2; ++j)
+		twiddles[j] = std::polar(1.0f, 2.0f * PI * j / n);
+
+	bitReverse.resize(n);
+	for (int i = 0; i < n; ++i) {
+		int r = 0;
+		for (int b = 0; b < logSize; ++b)
+			if (i & (1 << b))
+				r |= 1 << (logSize - 1 - b);
+		bitReverse[i] = r;
+	}
+
+	size_t samples = (size_t)n * n;
+	for (int i = 0; i < 3; ++i) {
+		fields[i].resize(samples);
+		scratch[i].resize(samples);
+	}
+	heights.assign(samples, 0.0f);
+	displacementX.assign(samples, 0.0f);
+	displacementZ.assign(samples, 0.0f);
+	normals.resize(samples * 3);
+	for (size_t i = 0; i < samples; ++i) {
+		normals[i * 3 + 0] = 0.0f;
+		normals[i * 3 + 1] = 1.0f;
+		normals[i * 3 + 2] = 0.0f;
+	}
+
+	buildSpectrum();
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TessendorfOcean::
+setWind(float speed, float direction)
+//========================================================================
+{
+	windSpeed = speed;
+	windDirection = direction;
+	buildSpectrum();
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TessendorfOcean::
+setSpectrum(Spectrum _spectrum)
+//========================================================================
+{
+	spectrum = _spectrum;
+	buildSpectrum();
+}
+
+//************************************************************************
+//
+// * signed wave number: indices past the middle are negative frequencies
+//========================================================================
+float TessendorfOcean::
+waveNumber(int i) const
+//========================================================================
+{
+	int n = i < size / 2 ? i : i - size;
+	return 2.0f * PI * n / patchLength;
+}
+
+//************************************************************************
+//
+// * Directional variance density of the chosen spectrum
+//========================================================================
+float TessendorfOcean::
+density(float kx, float kz) const
+//========================================================================
+{
+	float k = sqrt(kx * kx + kz * kz);
+	if (k < 1e-6f || windSpeed <= 0.0f)
+		return 0.0f;
+
+	float cosine = (kx * cos(windDirection) + kz * sin(windDirection)) / k;
+
+	// largest wave the wind can raise, and a cut for the tiny ones
+	float largest = windSpeed * windSpeed / GRAVITY;
+	float smallest = largest * 0.001f;
+	float suppress = exp(-k * k * smallest * smallest);
+
+	if (spectrum == PHILLIPS) {
+		float p = amplitude * exp(-1.0f / (k * largest * k * largest)) / (k * k * k * k) * cosine * cosine;
+		// waves running against the wind mostly die out
+		if (cosine < 0.0f)
+			p *= 0.07f;
+		return p * suppress;
+	}
+
+	// JONSWAP frequency spectrum S(w)
+	float w = sqrt(GRAVITY * k);
+	float alpha = 0.076f * pow(windSpeed * windSpeed / (fetch * GRAVITY), 0.22f);
+	float peak = 22.0f * pow(GRAVITY * GRAVITY / (windSpeed * fetch), 1.0f / 3.0f);
+	float sigma = w <= peak ? 0.07f : 0.09f;
+	float r = exp(-(w - peak) * (w - peak) / (2.0f * sigma * sigma * peak * peak));
+	float s = alpha * GRAVITY * GRAVITY / pow(w, 5.0f) * exp(-1.25f * pow(peak / w, 4.0f)) * pow(gamma, r);
+
+	// to wave numbers: S(k) = S(w) dw/dk / k, with dw/dk = g / 2w
+	s *= GRAVITY / (2.0f * w) / k;
+
+	// cos^2 spreading over the half plane facing the wind
+	if (cosine <= 0.0f)
+		return 0.0f;
+	return s * 2.0f / PI * cosine * cosine * suppress;
+}
+
+//************************************************************************
+//
+// * Draw the random amplitudes h0(k) for the current parameters
+//========================================================================
+void TessendorfOcean::
+buildSpectrum()
+//========================================================================
+{
+	int n = size;
+	size_t samples = (size_t)n * n;
+	h0.resize(samples);
+	h0Mirror.resize(samples);
+	omega.resize(samples);
+
+	// the same seed gives the same sea for any wind
+	std::mt19937 random(seed);
+	std::normal_distribution<float> gauss(0.0f, 1.0f);
+
+	float dk = 2.0f * PI / patchLength;
+	for (int z = 0; z < n; ++z) {
+		for (int x = 0; x < n; ++x) {
+			float kx = waveNumber(x);
+			float kz = waveNumber(z);
+			// the Nyquist row and column are their own mirror, so their
+			// slopes can't come out real; leave them flat
+			float variance = 0.0f;
+			if (x != n / 2 && z != n / 2)
+				variance = density(kx, kz) * dk * dk;
+			float xr = gauss(random);
+			float xi = gauss(random);
+			h0[z * n + x] = Complex(xr, xi) * sqrt(variance * 0.5f);
+			omega[z * n + x] = sqrt(GRAVITY * sqrt(kx * kx + kz * kz));
+		}
+	}
+	for (int z = 0; z < n; ++z)
+		for (int x = 0; x < n; ++x)
+			h0Mirror[z * n + x] = std::conj(h0[((n - z) % n) * n + (n - x) % n]);
+}
+
+//************************************************************************
+//
+// * Move every wave to time and build the spectra that get transformed
+//========================================================================
+void TessendorfOcean::
+evolveRows(int rowBegin, int rowEnd, float time)
+//========================================================================
+{
+	const Complex I(0.0f, 1.0f);
+	int n = size;
+	for (int z = rowBegin; z < rowEnd; ++z) {
+		float kz = waveNumber(z);
+		for (int x = 0; x < n; ++x) {
+			int i = z * n + x;
+			float kx = waveNumber(x);
+			float k = sqrt(kx * kx + kz * kz);
+
+			float wt = omega[i] * time;
+			Complex e(cos(wt), sin(wt));
+			Complex h = mul(h0[i], e) + mul(h0Mirror[i], std::conj(e));
+			if (fieldCount == 1) {
+				fields[0][i] = h;
+				continue;
+			}
+
+			// D = -i k/|k| h, slope = i k h
+			Complex dx(0.0f, 0.0f), dz(0.0f, 0.0f);
+			if (k > 1e-6f) {
+				dx = mul(-I, h) * (kx / k);
+				dz = mul(-I, h) * (kz / k);
+			}
+			Complex sx = mul(I, h) * kx;
+			Complex sz = mul(I, h) * kz;
+
+			fields[0][i] = h + mul(I, dx);
+			fields[1][i] = dz + mul(I, sx);
+			fields[2][i] = sz;
+		}
+	}
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TessendorfOcean::
+transformRows(std::vector<Complex>* rows, int rowBegin, int rowEnd)
+//========================================================================
+{
+	for (int f = 0; f < fieldCount; ++f)
+		for (int z = rowBegin; z < rowEnd; ++z)
+			transformRow(&rows[f][(size_t)z * size], size, &bitReverse[0], &twiddles[0]);
+}
+
+//************************************************************************
+//
+// * Transpose tile by tile so both sides stay in cache
+//========================================================================
+void TessendorfOcean::
+transposeBlocks(const std::vector<Complex>* from, std::vector<Complex>* to,
+				int blockBegin, int blockEnd)
+//========================================================================
+{
+	int n = size;
+	int block = std::min(BLOCK, n);
+	for (int f = 0; f < fieldCount; ++f) {
+		const Complex* in = &from[f][0];
+		Complex* out = &to[f][0];
+		for (int by = blockBegin * block; by < blockEnd * block; by += block)
+			for (int bx = 0; bx < n; bx += block)
+				for (int y = by; y < by + block; ++y)
+					for (int x = bx; x < bx + block; ++x)
+						out[(size_t)x * n + y] = in[(size_t)y * n + x];
+	}
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TessendorfOcean::
+resolveRows(int rowBegin, int rowEnd)
+//========================================================================
+{
+	int n = size;
+	if (fieldCount == 1) {
+		for (size_t i = (size_t)rowBegin * n; i < (size_t)rowEnd * n; ++i)
+			heights[i] = fields[0][i].real();
+		return;
+	}
+	for (int z = rowBegin; z < rowEnd; ++z) {
+		for (int x = 0; x < n; ++x) {
+			size_t i = (size_t)z * n + x;
+			heights[i] = fields[0][i].real();
+			displacementX[i] = choppiness * fields[0][i].imag();
+			displacementZ[i] = choppiness * fields[1][i].real();
+
+			normals[i * 3 + 0] = -fields[1][i].imag();
+			normals[i * 3 + 1] = 1.0f;
+			normals[i * 3 + 2] = -fields[2][i].real();
+		}
+		normalizeVec3s(&normals[(size_t)z * n * 3], n);
+	}
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+template <class F>
+void TessendorfOcean::
+forRows(int count, const F& body)
+//========================================================================
+{
+	if (size * size < MIN_SAMPLES_FOR_THREADS)
+		body(0, count);
+	else
+		ThreadPool::shared().parallelFor(count, body, threadCount);
+}
+
+//************************************************************************
+//
+// * Synthesize the fields asked for at time
+//========================================================================
+void TessendorfOcean::
+update(float time, Fields which)
+//========================================================================
+{
+	int blocks = size / std::min(BLOCK, size);
+	fieldCount = which == HEIGHTS ? 1 : 3;
+
+	forRows(size, [this, time](int begin, int end) { evolveRows(begin, end, time); });
+	// rows, then the columns as rows of the transpose
+	forRows(size, [this](int begin, int end) { transformRows(fields, begin, end); });
+	forRows(blocks, [this](int begin, int end) { transposeBlocks(fields, scratch, begin, end); });
+	forRows(size, [this](int begin, int end) { transformRows(scratch, begin, end); });
+	forRows(blocks, [this](int begin, int end) { transposeBlocks(scratch, fields, begin, end); });
+	forRows(size, [this](int begin, int end) { resolveRows(begin, end); });
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+float TessendorfOcean::
+heightAt(int x, int z) const
+//========================================================================
+{
+	return heights[(size_t)z * size + x];
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void TessendorfOcean::
+copyHeights(float* out, float scale) const
+//========================================================================
+{
+	size_t samples = (size_t)size * size;
+	for (size_t i = 0; i < samples; ++i)
+		out[i] = heights[i] * scale;
+}
@@ -19,6 +19,7 @@
 	 Platform:    Visio Studio.Net 2003/2005
 *************************************************************************/
 
+#include <algorithm>
 #include <iostream>
 #include <Fl/fl.h>
 
@@ -29,8 +30,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtx/transform.hpp>
 #include <GL/glu.h>
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+#include <FL/gl.h>
 #include <iostream>
 
 #include "TrainView.H"
@@ -60,6 +60,36 @@ struct Vertex {
 	}
 };
 
+static std::vector<std::string> skyboxFaces()
+{
+	std::vector<std::string> faces;
+	faces.push_back("Images/skybox/right.jpg");
+	faces.push_back("Images/skybox/left.jpg");
+	faces.push_back("Images/skybox/top.jpg");
+	faces.push_back("Images/skybox/bottom.jpg");
+	faces.push_back("Images/skybox/front.jpg");
+	faces.push_back("Images/skybox/back.jpg");
+	return faces;
+}
+
+static std::vector<std::string> heightMapFrames()
+{
+	std::vector<std::string> frames;
+	for (int i = 0; i < 200; ++i)
+	{
+		std::string name;
+		if (i < 10)
+			name = "00" + std::to_string(i);
+		else if (i < 100)
+			name = "0" + std::to_string(i);
+		else
+			name = std::to_string(i);
+
+		frames.push_back("Images/waves5/" + name + ".png");
+	}
+	return frames;
+}
+
 //************************************************************************
 //
 // * Constructor to set up the GL window
@@ -180,6 +210,65 @@ int TrainView::handle(int event)
 
 			return 1;
 		};
+		if (k == 'o') {
+			// show or hide the pass and draw timings
+			showProfiler = !showProfiler;
+			damage(1);
+			return 1;
+		}
+		if (k == 'd') {
+			// write the timings of the last frames
+			if (passTimer.dump("profile.csv"))
+				printf("Profile written to profile.csv\n");
+			else
+				printf("Cannot write profile.csv\n");
+			return 1;
+		}
+		if (k == 'r') {
+			// mirror the scene instead of the sky box
+			planarReflection = !planarReflection;
+			damage(1);
+			return 1;
+		}
+		if (k == 'q') {
+			waterQuality = (waterQuality + 1) % WaterFeatures::QUALITY_COUNT;
+			printf("Water quality %d\n", waterQuality);
+			damage(1);
+			return 1;
+		}
+		if (k == 'u') {
+			// next policy for redrawing the water targets
+			waterUpdatePolicy = (WaterFrameBuffers::UpdatePolicy)
+				((waterUpdatePolicy + 1) % WaterFrameBuffers::UPDATE_POLICY_COUNT);
+			if (waterFrameBuffers)
+				waterFrameBuffers->updatePolicy = waterUpdatePolicy;
+			printf("Water targets update policy %s, interval %d\n",
+				BenchmarkSettings::updatePolicyName(waterUpdatePolicy), waterUpdateInterval);
+			damage(1);
+			return 1;
+		}
+		if (k == 'g') {
+			// step the ripples on the other processor, both start over
+			// from flat water
+			if (gpuWaveSolver) {
+				gpuWaves = !gpuWaves;
+				waveSolver->reset();
+				gpuWaveSolver->reset();
+				printf("Ripple solver on the %s\n", gpuWaves ? "GPU" : "CPU");
+			}
+			else
+				printf("No compute shaders, the ripples stay on the CPU\n");
+			damage(1);
+			return 1;
+		}
+		if (k == 't') {
+			// write the events the trace still holds
+			if (TraceRecorder::shared().flush("trace.json"))
+				printf("Trace written to trace.json\n");
+			else
+				printf("Cannot write trace.json\n");
+			return 1;
+		}
 		break;
 	}
 
@@ -204,52 +293,191 @@ void TrainView::draw()
 	{
 		//initiailize VAO, VBO, Shader...
 
-		if (!this->skyboxShader)
-			this->initSkyboxShader();
+		// every program goes to the driver first and builds while the
+		// images decode on the worker threads; the init functions below
+		// only wait for and upload the images, and the shaders are only
+		// waited for once all of that is done
+		if (!this->shaderManager)
+		{
+			this->assets = new AssetLoader();
+			this->queueAssets();
+			this->submitShaders();
 
-		if (!this->tilesShader)
+			this->initSkyboxShader();
 			this->initTilesShader();
-
-		if (!this->waterShader)
 			this->initWaterShader();
-
-		if (!this->sineWaveShader)
 			this->initSineWaveShader();
-
-		if (!this->heightMapShader)
 			this->initHeightMapShader();
+		}
+
+		if (!this->waveSolver)
+			this->initWaveSolver();
+
+		if (!this->ocean)
+			this->initOcean();
 
 		if (!this->waterFrameBuffers)
-			this->waterFrameBuffers = new WaterFrameBuffers();
+		{
+			this->waterFrameBuffers = new WaterFrameBuffers(pixel_w(), pixel_h());
+			this->waterFrameBuffers->updatePolicy = this->waterUpdatePolicy;
+			this->waterFrameBuffers->updateInterval = this->waterUpdateInterval;
+			this->waterFrameBuffers->moveThreshold = this->waterMoveThreshold;
+			this->waterFrameBuffers->turnThreshold = this->waterTurnThreshold;
+			glGenQueries(FRAME_TIME_QUERIES, this->frameTimeQueries);
+			this->frameGraph.timer = &this->passTimer;
+			this->renderer = (const char*)glGetString(GL_RENDERER);
+			this->reflectionTarget = this->frameGraph.addTarget("reflection");
+			this->refractionTarget = this->frameGraph.addTarget("refraction");
+		}
 
-		if (!this->planeShader)
+		if (!this->n_plane)
 			this->initPlaneShader();
 
-		if (!this->commom_matrices)
-			this->commom_matrices = new UBO();
-		this->commom_matrices->size = 2 * sizeof(glm::mat4);
-		glGenBuffers(1, &this->commom_matrices->ubo);
-		glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
-		glBufferData(GL_UNIFORM_BUFFER, this->commom_matrices->size, NULL, GL_STATIC_DRAW);
-		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		if (this->assets)
+		{
+			this->assets->report(std::cout);
+			delete this->assets;
+			this->assets = nullptr;
+
+			this->shaderManager->finishAll();
+			this->shaderManager->report(std::cout);
+
+			ProgramCache& cache = ProgramCache::shared();
+			std::cout << "SHADER::CACHE " << cache.hits << " hits, " << cache.misses
+				<< " misses, " << cache.savedMs << " ms of compiling saved" << std::endl;
+		}
+
+		// reflection, refraction and screen pass
+		if (!this->frameConstants)
+			this->frameConstants = new FrameConstants(3);
+
+		if (!this->dropBuffer)
+		{
+			this->dropBuffer = new UBO();
+			this->dropBuffer->size = sizeof(DropBlock);
+			glGenBuffers(1, &this->dropBuffer->ubo);
+			glBindBuffer(GL_UNIFORM_BUFFER, this->dropBuffer->ubo);
+			glBufferData(GL_UNIFORM_BUFFER, this->dropBuffer->size, NULL, GL_DYNAMIC_DRAW);
+			glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		}
 	}
 	else
 		throw std::runtime_error("Could not initialize GLAD!");
 
-	glEnable(GL_CLIP_DISTANCE0);
+	// the GPU time of a frame a few frames back drives the resolution of
+	// the water targets; its query is long done, so this never stalls
+	GLuint& frameTimeQuery = this->frameTimeQueries[this->frameTimeQuery];
+	if (this->frameTimePending[this->frameTimeQuery])
+	{
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(frameTimeQuery, GL_QUERY_RESULT, &elapsed);
+		this->gpuFrameMs = elapsed / 1000000.0f;
+		// a benchmark keeps the resolution fixed, so runs compare
+		if (!this->benchmark && this->frameTimeTargets[this->frameTimeQuery])
+			this->waterFrameBuffers->adapt(this->gpuFrameMs);
+	}
+	this->passTimer.beginFrame();
+	if (this->benchmark)
+	{
+		this->benchmark->drawn(this->passTimer.results, this->gpuFrameMs,
+			this->waterFrameBuffers->getScale());
+		this->benchmarkFramePending = false;
+	}
+	if (this->cameraRecording && tw->worldCam->value())
+		this->cameraRecording->record(this->arcball.getPose());
 
-	this->waterFrameBuffers->bindReflectionFrameBuffer();
-	//float distance = 2 * (arcball.getPosition().y - 0.6f);	
-	//gluLookAt(arcball.getPosition().x, arcball.getPosition().y - distance, arcball.getPosition().z, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f);
-	draw(glm::vec4(0.0f, 1.0f, 0.0f, -0.6f * 100.0f), true);
+	glBeginQuery(GL_TIME_ELAPSED, frameTimeQuery);
+	this->waterFrameBuffers->beginFrame(pixel_w(), pixel_h());
 
-	this->waterFrameBuffers->bindRefractionFrameBuffer();	
-	draw(glm::vec4(0.0f, -1.0f, 0.0f, 0.6f * 100.0f), false);
+	this->frameConstants->beginFrame();
+	this->updateCamera();
 
-	glDisable(GL_CLIP_DISTANCE0);
-	this->waterFrameBuffers->unbindCurrentFrameBuffer();
-	
-	draw(glm::vec4(0.0f, -1.0f, 0.0f, 0.6f * 100.0f), false);
+	// the drops are the same for every pass, upload them once per frame
+	{
+		PassTimer::Scope scope(this->passTimer, "drops");
+		setDropUBO();
+		glBindBufferRange(
+			GL_UNIFORM_BUFFER, /*binding point*/1, this->dropBuffer->ubo, 0, this->dropBuffer->size);
+	}
+
+	{
+		PassTimer::Scope scope(this->passTimer, "wave upload");
+		if (tw->waveBrowser->value() == 3 && useGpuWaves())
+			this->gpuWaveSolver->update();
+		else if (tw->waveBrowser->value() == 3)
+			updateWaveTexture();
+		else if (tw->waveBrowser->value() == 4)
+			updateOceanTexture();
+		else if (tw->waveBrowser->value() == 2)
+			this->heightMapLayer = this->heightMapStream ?
+				this->heightMapStream->update(this->heightMapIndex) : (int)this->heightMapIndex;
+	}
+	this->updateWaterSurface();
+
+	// the offscreen passes only run when the screen pass samples what
+	// they render. Only the planar reflection variants of the water and
+	// the debug plane read the reflection, nothing reads the refraction,
+	// so normally the scene is drawn once instead of three times
+	this->frameGraph.reset();
+
+	int reflectionPass = this->frameGraph.addPass("reflection", [this]() {
+		if (!this->waterFrameBuffers->beginReflectionUpdate(this->reflectedCamera))
+			return;
+		glEnable(GL_CLIP_DISTANCE0);
+		draw(glm::vec4(0.0f, 1.0f, 0.0f, -this->waterLevel), true);
+		glDisable(GL_CLIP_DISTANCE0);
+		this->waterFrameBuffers->endUpdate();
+	});
+	this->frameGraph.write(reflectionPass, this->reflectionTarget);
+
+	int refractionPass = this->frameGraph.addPass("refraction", [this]() {
+		if (!this->waterFrameBuffers->beginRefractionUpdate(this->camera))
+			return;
+		glEnable(GL_CLIP_DISTANCE0);
+		draw(glm::vec4(0.0f, -1.0f, 0.0f, this->waterLevel), false);
+		glDisable(GL_CLIP_DISTANCE0);
+		this->waterFrameBuffers->endUpdate();
+	});
+	this->frameGraph.write(refractionPass, this->refractionTarget);
+
+	int screenPass = this->frameGraph.addPass("screen", [this]() {
+		this->waterFrameBuffers->unbindCurrentFrameBuffer();
+		draw(glm::vec4(0.0f, -1.0f, 0.0f, this->waterLevel), false);
+		if (this->showReflectionPlane)
+			drawPlane();
+	}, true);
+	if (this->showReflectionPlane || this->planarReflection)
+		this->frameGraph.read(screenPass, this->reflectionTarget);
+
+	this->frameGraph.execute();
+
+	if (this->showProfiler)
+		drawProfilerOverlay();
+
+	this->frameConstants->endFrame();
+
+	glEndQuery(GL_TIME_ELAPSED);
+	this->frameTimePending[this->frameTimeQuery] = true;
+	this->frameTimeTargets[this->frameTimeQuery] = this->waterFrameBuffers->drewTargets();
+	this->frameTimeQuery = (this->frameTimeQuery + 1) % FRAME_TIME_QUERIES;
+
+	this->drawEnd = TraceRecorder::shared().now();
+}
+
+void TrainView::
+flush()
+{
+	TraceRecorder& trace = TraceRecorder::shared();
+	trace.beginFrame();
+	char name[32];
+	sprintf(name, "frame %d", trace.currentFrame());
+	TraceRecorder::Scope frame("frame", name);
+
+	int64_t start = trace.now();
+	Fl_Gl_Window::flush();
+	// FLTK swaps the buffers right after draw() returns
+	if (this->drawEnd > start)
+		trace.record("swap", "swap", this->drawEnd, trace.now());
 }
 
 void TrainView::
@@ -267,10 +495,9 @@ draw(glm::vec4 plane, bool reflection)
 	// Blayne prefers GL_DIFFUSE
 	glColorMaterial(GL_FRONT_AND_BACK, GL_AMBIENT_AND_DIFFUSE);
 
-	// prepare for projection
-	glMatrixMode(GL_PROJECTION);
-	glLoadIdentity();
-	setProjection();		// put the code to set up matrices here
+	// the reflection pass looks up at the scene from under the water
+	const Camera& view = reflection ? this->reflectedCamera : this->camera;
+	view.load();		// for the fixed-function drawing below
 
 	//######################################################################
 	// TODO: 
@@ -331,40 +558,41 @@ draw(glm::vec4 plane, bool reflection)
 	glEnable(GL_LIGHTING);
 	setupObjects();
 
-	drawStuff();
+	{
+		PassTimer::Scope scope(this->passTimer, "objects");
+		drawStuff();
+	}
 
 	// this time drawing is for shadows (except for top view)
 	if (!tw->topCam->value()) {
+		PassTimer::Scope scope(this->passTimer, "shadows");
 		setupShadows();
 		drawStuff(true);
 		unsetupShadows();
 	}
 
-	setUBO();
-	glBindBufferRange(
-		GL_UNIFORM_BUFFER, /*binding point*/0, this->commom_matrices->ubo, 0, this->commom_matrices->size);
-
-	glm::mat4 view;
-	glm::mat4 projection;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection[0][0]);
-
-	
+	setUBO(view);
 
 	//draw tiles
-	drawTiles(plane, reflection);
+	{
+		PassTimer::Scope scope(this->passTimer, "tiles");
+		drawTiles(plane, reflection);
+	}
 
 	//draw water
-	if (tw->waveBrowser->value() == 1)
-		drawSineWave(reflection);
-	else if (tw->waveBrowser->value() == 2)
-		drawHeightMapWave();
-
-	//drawPlane();
+	{
+		PassTimer::Scope scope(this->passTimer, "water");
+		if (tw->waveBrowser->value() == 1)
+			drawSineWave(reflection);
+		else if (tw->waveBrowser->value() >= 2)
+			drawHeightMapWave(reflection);
+	}
 
 	//draw skybox
-	drawSkyBox(reflection);
+	{
+		PassTimer::Scope scope(this->passTimer, "skybox");
+		drawSkyBox(reflection);
+	}
 }
 
 //************************************************************************
@@ -376,13 +604,30 @@ draw(glm::vec4 plane, bool reflection)
 void TrainView::
 setProjection()
 //========================================================================
+{
+	this->updateCamera();
+
+	// on top of whatever the caller left there (the pick matrix)
+	glMatrixMode(GL_PROJECTION);
+	glMultMatrixf(&this->camera.projection[0][0]);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(&this->camera.view[0][0]);
+}
+
+//************************************************************************
+//
+// * The view and projection of the selected camera, built on the CPU
+//========================================================================
+void TrainView::
+updateCamera()
+//========================================================================
 {
 	// Compute the aspect ratio (we'll need it)
 	float aspect = static_cast<float>(w()) / static_cast<float>(h());
 
 	// Check whether we use the world camp
 	if (tw->worldCam->value())
-		arcball.setProjection(false);
+		this->camera.set(arcball.getViewMatrix(), arcball.getProjectionMatrix());
 	// Or we use the top cam
 	else if (tw->topCam->value()) {
 		float wi, he;
@@ -397,15 +642,14 @@ setProjection()
 
 		// Set up the top camera drop mode to be orthogonal and set
 		// up proper projection matrix
-		glMatrixMode(GL_PROJECTION);
-		glOrtho(-wi, wi, -he, he, 200, -200);
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
-		glRotatef(-90, 1, 0, 0);
+		this->camera.set(glm::rotate(glm::mat4(1.0f), glm::radians(-90.0f), glm::vec3(1.0f, 0.0f, 0.0f)),
+						 glm::ortho(-wi, wi, -he, he, 200.0f, -200.0f));
 	}
 	else {
 
 	}
+
+	this->reflectedCamera = this->camera.reflected(this->waterLevel);
 }
 
 //************************************************************************
@@ -504,47 +748,60 @@ doPick()
 	printf("Selected Cube %d\n", selectedCube);
 }
 
-void TrainView::setUBO()
+void TrainView::setUBO(const Camera& view)
 {
-	float wdt = this->pixel_w();
-	float hgt = this->pixel_h();
-
-	glm::mat4 view_matrix;
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	//HMatrix view_matrix; 
-	//this->arcball.getMatrix(view_matrix);
-
-	glm::mat4 projection_matrix;
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-	//projection_matrix = glm::perspective(glm::radians(this->arcball.getFoV()), (GLfloat)wdt / (GLfloat)hgt, 0.01f, 1000.0f);
-
-	glBindBuffer(GL_UNIFORM_BUFFER, this->commom_matrices->ubo);
-	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), &projection_matrix[0][0]);
-	glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), &view_matrix[0][0]);
-	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	FrameConstantsBlock block;
+
+	block.view = view.view;
+	block.projection = view.projection;
+
+	this->cameraPosition = view.position;
+
+	block.cameraPosition = glm::vec4(this->cameraPosition, 1.0f);
+	block.lightPosition = glm::vec4(this->lightPosition, 1.0f);
+	block.lightColor = glm::vec4(this->lightColor, 1.0f);
+	block.time = this->t_time + this->renderTimeOffset;
+
+	this->frameConstants->push(block, /*binding point*/0);
+}
+
+void TrainView::
+setDropUBO()
+{
+	expireDrops(this->allDrop, t_time);
+	uploadDrops(*this->dropBuffer, this->allDrop);
+}
+
+void TrainView::
+queueAssets()
+{
+	std::vector<std::string> faces = skyboxFaces();
+	for (size_t i = 0; i < faces.size(); ++i)
+		this->assets->queue(faces[i]);
+
+	this->assets->queue(PROJECT_DIR "/Images/tiles.jpg");
+	this->assets->queue(PROJECT_DIR "/Images/church.png");
+
+	if (this->heightMapSequence.open("Images/waves5.hmsq"))
+		return;
+	std::vector<std::string> frames = heightMapFrames();
+	for (size_t i = 0; i < frames.size(); ++i)
+		this->assets->queue(frames[i], Texture2DArray::READ_FLAGS);
 }
 
 unsigned int TrainView::
-loadCubemap(std::vector<std::string> faces)
+loadCubemap(const std::vector<std::string>& faces)
 {
 	unsigned int textureID;
 	glGenTextures(1, &textureID);
 	glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
 
-	int width, height, nrComponents;
 	for (unsigned int i = 0; i < faces.size(); i++)
 	{
-		unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrComponents, 0);
-		if (data)
-		{
-			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-			stbi_image_free(data);
-		}
-		else
-		{
-			std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-			stbi_image_free(data);
-		}
+		this->assets->upload(faces[i], [&](const cv::Mat& img) {
+			if (!img.empty())
+				glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, img.cols, img.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, img.data);
+		});
 	}
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -556,84 +813,57 @@ loadCubemap(std::vector<std::string> faces)
 }
 
 void TrainView::
-initSkyboxShader()
+submitShaders()
 {
-	this->skyboxShader = new Shader(PROJECT_DIR "/src/shaders/skybox.vert",
+	this->shaderManager = new ShaderManager();
+
+	this->skyboxShader = this->shaderManager->submit(PROJECT_DIR "/src/shaders/skybox.vert",
 		nullptr, nullptr, nullptr,
 		PROJECT_DIR "/src/shaders/skybox.frag");
+	this->tilesShader = this->shaderManager->submit(PROJECT_DIR "/src/shaders/tiles.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/tiles.frag");
+	this->waterShader = this->shaderManager->submit(PROJECT_DIR "/src/shaders/water.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/water.frag");
+	this->planeShader = this->shaderManager->submit(PROJECT_DIR "/src/shaders/simple.vert",
+		nullptr, nullptr, nullptr,
+		PROJECT_DIR "/src/shaders/simple.frag");
 
-	float skyboxVertices[] = {
-		// positions          
-		-1.0f,  1.0f, -1.0f,
-		-1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f, -1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-
-		-1.0f, -1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f,
-		-1.0f, -1.0f,  1.0f,
-
-		-1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f, -1.0f,
-		 1.0f,  1.0f,  1.0f,
-		 1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f,  1.0f,
-		-1.0f,  1.0f, -1.0f,
-
-		-1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f, -1.0f,
-		 1.0f, -1.0f, -1.0f,
-		-1.0f, -1.0f,  1.0f,
-		 1.0f, -1.0f,  1.0f
-	};
+	// the water variants of the first frames: every wave model at full
+	// quality, with and without drops
+	this->waterVariants = new ShaderVariants(PROJECT_DIR "/src/shaders", this->shaderManager);
+	for (int model = WaterFeatures::WAVE_SINE; model <= WaterFeatures::WAVE_OCEAN; ++model)
+	{
+		WaterFeatures features;
+		features.waveModel = model;
+		this->waterVariants->prepare(features);
+		features.drops = true;
+		this->waterVariants->prepare(features);
+	}
+	if (GpuWaveSolver::supported())
+	{
+		// and the ripples of the GPU solver
+		WaterFeatures features;
+		features.waveModel = WaterFeatures::WAVE_RIPPLES;
+		features.normalMap = true;
+		this->waterVariants->prepare(features);
+	}
+}
 
+void TrainView::
+initSkyboxShader()
+{
 	// skybox VAO
-	glGenVertexArrays(1, &skyboxVAO);
-	glGenBuffers(1, &skyboxVBO);
-	glBindVertexArray(skyboxVAO);
-	glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(skyboxVertices), &skyboxVertices, GL_STATIC_DRAW);
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	skyboxVAO = createSkyboxVAO(&skyboxVBO);
 
 	//load textures
-	vector<std::string> faces;
-	faces.push_back("Images/skybox/right.jpg");
-	faces.push_back("Images/skybox/left.jpg");
-	faces.push_back("Images/skybox/top.jpg");
-	faces.push_back("Images/skybox/bottom.jpg");
-	faces.push_back("Images/skybox/front.jpg");
-	faces.push_back("Images/skybox/back.jpg");
-	cubemapTexture = loadCubemap(faces);
+	cubemapTexture = loadCubemap(skyboxFaces());
 }
 
 void TrainView::
 initTilesShader()
 {
-	this->tilesShader = new Shader(PROJECT_DIR "/src/shaders/tiles.vert",
-									nullptr, nullptr, nullptr,
-									PROJECT_DIR "/src/shaders/tiles.frag");
-
 	GLfloat  vertices[] = {
 		// back
 		1.0f, -1.0f, -1.0f,
@@ -799,16 +1029,14 @@ initTilesShader()
 	glBindVertexArray(0);
 
 	if (!this->tilesTexture)
-		this->tilesTexture = new Texture2D(PROJECT_DIR "/Images/tiles.jpg");
+		this->assets->upload(PROJECT_DIR "/Images/tiles.jpg", [this](const cv::Mat& img) {
+			this->tilesTexture = new Texture2D(img);
+		});
 }
 
 void TrainView::
 initWaterShader()
 {
-	this->waterShader = new Shader(PROJECT_DIR "/src/shaders/water.vert",
-									nullptr, nullptr, nullptr,
-									PROJECT_DIR "/src/shaders/water.frag");
-
 	GLfloat vertices[] = {
 		// back
 		1.0f, -1.0f, -1.0f,
@@ -971,112 +1199,25 @@ initWaterShader()
 	glBindVertexArray(0);
 
 	if (!this->waterTexture)
-		this->waterTexture = new Texture2D(PROJECT_DIR "/Images/church.png");
+		this->assets->upload(PROJECT_DIR "/Images/church.png", [this](const cv::Mat& img) {
+			this->waterTexture = new Texture2D(img);
+		});
 }
 
 void TrainView::
-initSineWaveShader()
+initWaterGrid()
 {
-	this->sineWaveShader = new Shader(PROJECT_DIR "/src/shaders/cubemaps.vert",
-										nullptr, nullptr, nullptr,
-										PROJECT_DIR "/src/shaders/cubemaps.frag");
-
-	float size = 0.01f;
-	unsigned int width = 2.0f / size;
-	unsigned int height = 2.0f / size;
-
-	GLfloat* vertices = new GLfloat[width * height * 4 * 3]();
-	GLfloat* normal = new GLfloat[width * height * 4 * 3]();
-	GLfloat* texture_coordinate = new GLfloat[width * height * 4 * 2]();
-	GLuint* element = new GLuint[width * height * 6]();
-
-	for (int i = 0; i < width * height * 4 * 3; i += 12)
-	{
-		unsigned int h = i / 12 / width;
-		unsigned int w = i / 12 % width;
-
-		vertices[i] = w * size - 1.0f + size;
-		vertices[i + 1] = 0.6f;
-		vertices[i + 2] = h * size - 1.0f + size;
-
-		vertices[i + 3] = vertices[i] - size;
-		vertices[i + 4] = 0.6f;
-		vertices[i + 5] = vertices[i + 2];
-
-		vertices[i + 6] = vertices[i + 3];
-		vertices[i + 7] = 0.6f;
-		vertices[i + 8] = vertices[i + 5] - size;
-
-		vertices[i + 9] = vertices[i];
-		vertices[i + 10] = 0.6f;
-		vertices[i + 11] = vertices[i + 8];
-	}
-
-	for (int i = 0; i < width * height * 4 * 3; i += 3)
-	{
-		normal[i] = 0.0f;
-		normal[i + 1] = 1.0f;
-		normal[i + 2] = 0.0f;
-	}
-
-	for (int i = 0; i < width * height * 4 * 2; i += 8)
-	{
-		texture_coordinate[i] = 1.0f;
-		texture_coordinate[i + 1] = 1.0f;
-
-		texture_coordinate[i + 2] = 0.0f;
-		texture_coordinate[i + 3] = 1.0f;
-
-		texture_coordinate[i + 4] = 0.0f;
-		texture_coordinate[i + 5] = 0.0f;
-
-		texture_coordinate[i + 6] = 1.0f;
-		texture_coordinate[i + 7] = 0.0f;
-	}
-
-	for (int i = 0, j = 0; i < width * height * 6; i += 6, j += 4)
-	{
-		element[i] = j + 1;
-		element[i + 1] = j;
-		element[i + 2] = j + 3;
-
-		element[i + 3] = element[i + 2];
-		element[i + 4] = j + 2;
-		element[i + 5] = element[i];
-	}
-
-	this->sineWave = new VAO;
-	this->sineWave->element_amount = width * height * 6;
-	glGenVertexArrays(1, &this->sineWave->vao);
-	glGenBuffers(3, this->sineWave->vbo);
-	glGenBuffers(1, &this->sineWave->ebo);
-
-	glBindVertexArray(this->sineWave->vao);
-
-	// Position attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->sineWave->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
-
-	// Normal attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->sineWave->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), normal, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(1);
-
-	// Texture Coordinate attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->sineWave->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 2 * sizeof(GLfloat), texture_coordinate, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(2);
-
-	//Element attribute
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->sineWave->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, width * height * 6 * sizeof(GLuint), element, GL_STATIC_DRAW);
+	// one (N+1)x(N+1) lattice at the water level, shared by the sine wave
+	// and heightmap modes
+	GridMesh grid(WATER_GRID_RESOLUTION);
+	this->waterGrid = grid.createVAO();
+}
 
-	// Unbind VAO
-	glBindVertexArray(0);
+void TrainView::
+initSineWaveShader()
+{
+	if (!this->waterGrid)
+		this->initWaterGrid();
 
 	//if (!this->sineWaveTexture)
 	//	this->sineWaveTexture = new Texture2D(PROJECT_DIR "/Images/tiles.jpg");
@@ -1089,131 +1230,167 @@ initSineWaveShader()
 void TrainView::
 initHeightMapShader()
 {
-	this->heightMapShader = new Shader{ PROJECT_DIR "/src/shaders/heightMap.vert",
-										nullptr, nullptr, nullptr,
-										PROJECT_DIR "/src/shaders/heightMap.frag"};
+	if (!this->waterGrid)
+		this->initWaterGrid();
 
-	float size = 0.01f;
-	unsigned int width = 2.0f / size;
-	unsigned int height = 2.0f / size;
-
-	GLfloat* vertices = new GLfloat[width * height * 4 * 3]();
-	GLfloat* normal = new GLfloat[width * height * 4 * 3]();
-	GLfloat* texture_coordinate = new GLfloat[width * height * 4 * 2]();
-	GLuint* element = new GLuint[width * height * 6]();
-
-	for (int i = 0; i < width * height * 4 * 3; i += 12)
+	if (this->heightMapSequence.isOpen() && this->streamHeightMaps && HeightMapStream::supported())
 	{
-		unsigned int h = i / 12 / width;
-		unsigned int w = i / 12 % width;
-
-		vertices[i] = w * size - 1.0f + size;
-		vertices[i + 1] = 0.6f;
-		vertices[i + 2] = h * size - 1.0f + size;
-
-		vertices[i + 3] = vertices[i] - size;
-		vertices[i + 4] = 0.6f;
-		vertices[i + 5] = vertices[i + 2];
-
-		vertices[i + 6] = vertices[i + 3];
-		vertices[i + 7] = 0.6f;
-		vertices[i + 8] = vertices[i + 5] - size;
-
-		vertices[i + 9] = vertices[i];
-		vertices[i + 10] = 0.6f;
-		vertices[i + 11] = vertices[i + 8];
+		// the sequence stays mapped, the stream reads from it as it plays
+		this->heightMapStream = new HeightMapStream(this->heightMapSequence, this->heightMapWindow);
+		this->heightMapTexture = this->heightMapStream->texture;
 	}
-
-	for (int i = 0; i < width * height * 4 * 3; i += 3)
+	else if (this->heightMapSequence.isOpen())
 	{
-		normal[i] = 0.0f;
-		normal[i + 1] = 1.0f;
-		normal[i + 2] = 0.0f;
+		// straight from the mapping, no decode; the mapping stays for
+		// waterSurface, only the pages it reads are kept in memory
+		const HeightMapSequenceHeader& header = this->heightMapSequence.header;
+		this->heightMapTexture = new Texture2DArray(header.width, header.height, header.frameCount,
+													header.bytesPerPixel == 2 ? GL_R16 : GL_R8);
+		for (unsigned int i = 0; i < header.frameCount; ++i)
+			this->heightMapTexture->upload(i, this->heightMapSequence.frame(i));
 	}
-
-	for (int i = 0; i < width * height * 4 * 2; i += 8)
+	else
 	{
-		texture_coordinate[i] = 1.0f;
-		texture_coordinate[i + 1] = 1.0f;
-
-		texture_coordinate[i + 2] = 0.0f;
-		texture_coordinate[i + 3] = 1.0f;
-
-		texture_coordinate[i + 4] = 0.0f;
-		texture_coordinate[i + 5] = 0.0f;
-
-		texture_coordinate[i + 6] = 1.0f;
-		texture_coordinate[i + 7] = 0.0f;
+		std::vector<std::string> frames = heightMapFrames();
+		this->heightMapTexture = new Texture2DArray(0, 0, (int)frames.size(), GL_R8);
+		for (size_t i = 0; i < frames.size(); ++i)
+		{
+			this->assets->upload(frames[i], [&](const cv::Mat& img) {
+				this->heightMapTexture->uploadImage((int)i, img, &this->heightMapPixels);
+			});
+		}
 	}
 
-	for (int i = 0, j = 0; i < width * height * 6; i += 6, j += 4)
-	{
-		element[i] = j + 1;
-		element[i + 1] = j;
-		element[i + 2] = j + 3;
-
-		element[i + 3] = element[i + 2];
-		element[i + 4] = j + 2;
-		element[i + 5] = element[i];
-	}
+	//if (!this->sineWaveTexture)
+	//	this->sineWaveTexture = new Texture2D(PROJECT_DIR "/Images/tiles.jpg");
+}
 
-	this->heightMap = new VAO;
-	this->heightMap->element_amount = width * height * 6;
-	glGenVertexArrays(1, &this->heightMap->vao);
-	glGenBuffers(3, this->heightMap->vbo);
-	glGenBuffers(1, &this->heightMap->ebo);
+void TrainView::
+initWaveSolver()
+{
+	// one cell per grid vertex
+	this->waveSolver = new WaveSolver(WATER_GRID_RESOLUTION + 1, WATER_GRID_RESOLUTION + 1);
+	this->waveHeights.resize(this->waveSolver->getWidth() * this->waveSolver->getHeight());
+
+	// a single layer, so the heightmap shader samples it like the frames
+	this->waveHeightTexture = new Texture2DArray(this->waveSolver->getWidth(), this->waveSolver->getHeight(), 1, GL_R32F);
+	this->waveHeightTexture->setWrap(GL_CLAMP_TO_EDGE);
+
+	// the same grid on the GPU, its heights never leave it
+	if (GpuWaveSolver::supported())
+		this->gpuWaveSolver = new GpuWaveSolver(this->waveSolver->getWidth(), this->waveSolver->getHeight(),
+			PROJECT_DIR "/src/shaders", this->shaderManager);
+}
 
-	glBindVertexArray(this->heightMap->vao);
+void TrainView::
+updateWaveTexture()
+{
+	this->waveSolver->copyHeights(&this->waveHeights[0]);
 
-	// Position attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[0]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), vertices, GL_STATIC_DRAW);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(0);
+	this->waveHeightTexture->upload(0, &this->waveHeights[0]);
+}
 
-	// Normal attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[1]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 3 * sizeof(GLfloat), normal, GL_STATIC_DRAW);
-	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(1);
+void TrainView::
+initOcean()
+{
+	this->ocean = new TessendorfOcean(256);
+	this->oceanHeights.resize(this->ocean->getSize() * this->ocean->getSize());
 
-	// Texture Coordinate attribute
-	glBindBuffer(GL_ARRAY_BUFFER, this->heightMap->vbo[2]);
-	glBufferData(GL_ARRAY_BUFFER, width * height * 4 * 2 * sizeof(GLfloat), texture_coordinate, GL_STATIC_DRAW);
-	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(GLfloat), (GLvoid*)0);
-	glEnableVertexAttribArray(2);
+	// the patch is periodic, so the texture keeps the default repeat wrap
+	this->oceanHeightTexture = new Texture2DArray(this->ocean->getSize(), this->ocean->getSize(), 1, GL_R32F);
+	this->ocean->update(this->oceanTime, TessendorfOcean::HEIGHTS);
+}
 
-	//Element attribute
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->heightMap->ebo);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, width * height * 6 * sizeof(GLuint), element, GL_STATIC_DRAW);
+void TrainView::
+updateOceanTexture()
+{
+	this->ocean->copyHeights(&this->oceanHeights[0], this->oceanHeightScale);
 
-	// Unbind VAO
-	glBindVertexArray(0);
+	this->oceanHeightTexture->upload(0, &this->oceanHeights[0]);
+}
 
-	for (int i = 0; i < 200; ++i)
+void TrainView::
+updateWaterSurface()
+{
+	// the model matrix and uniforms of drawSineWave / drawHeightMapWave
+	this->waterSurface.setPlacement(this->source_pos.x, this->source_pos.y, this->source_pos.z, 100.0f);
+	float amplitude = (float)tw->amplitude->value();
+	float time = this->t_time + this->renderTimeOffset;
+
+	int model = tw->waveBrowser->value();
+	if (model == WaterSurface::SINE)
+		this->waterSurface.setSine(amplitude, (float)tw->waveLength->value(), time);
+	else if (model == WaterSurface::RIPPLES)
 	{
-		std::string name;
-		if (i < 10)
-			name = "00" + std::to_string(i);
-		else if (i < 100)
-			name = "0" + std::to_string(i);
-		else
-			name = std::to_string(i);
+		// the GPU solver keeps its heights on the GPU, the water reads flat then
+		this->waterSurface.setHeightField(WaterSurface::RIPPLES,
+			this->useGpuWaves() ? nullptr : &this->waveHeights[0], WaterSurface::FLOAT,
+			this->waveSolver->getWidth(), this->waveSolver->getHeight(), false, 0.0f, amplitude);
+	}
+	else if (model == WaterSurface::OCEAN)
+		this->waterSurface.setHeightField(WaterSurface::OCEAN, &this->oceanHeights[0], WaterSurface::FLOAT,
+			this->ocean->getSize(), this->ocean->getSize(), true, 0.0f, amplitude);
+	else
+	{
+		// the frame in the layer drawn, which lags heightMapIndex while
+		// the stream waits for it
+		const void* texels = nullptr;
+		WaterSurface::Format format = WaterSurface::UNORM8;
+		int width = 0, height = 0;
+		if (this->heightMapSequence.isOpen())
+		{
+			const HeightMapSequenceHeader& header = this->heightMapSequence.header;
+			int frame = this->heightMapStream ?
+				this->heightMapStream->frameIn(this->heightMapLayer) : this->heightMapLayer;
+			if (frame >= 0 && frame < (int)header.frameCount && frame != this->heightMapSurfaceFrame)
+			{
+				this->heightMapSurfaceFrame = frame;
+				this->heightMapSurfaceTexels = this->heightMapSequence.frame(frame);
+			}
+			if (frame == this->heightMapSurfaceFrame)
+				texels = this->heightMapSurfaceTexels;
+			if (header.bytesPerPixel == 2)
+				format = WaterSurface::UNORM16;
+			width = header.width;
+			height = header.height;
+		}
+		else if (!this->heightMapPixels.empty())
+		{
+			width = this->heightMapTexture->size.x;
+			height = this->heightMapTexture->size.y;
+			size_t frameBytes = (size_t)width * height;
+			if ((size_t)(this->heightMapLayer + 1) * frameBytes <= this->heightMapPixels.size())
+				texels = &this->heightMapPixels[(size_t)this->heightMapLayer * frameBytes];
+		}
+		this->waterSurface.setHeightField(WaterSurface::HEIGHTMAP, texels, format,
+			width, height, true, 0.5f, amplitude);
+	}
 
-		this->heightMapTexture.push_back(Texture2D (("Images/waves5/" + name + ".png").c_str()));
+	std::vector<WaterSurface::Ripple> ripples(this->allDrop.size());
+	for (size_t i = 0; i < this->allDrop.size(); ++i)
+	{
+		ripples[i].u = this->allDrop[i].point.x;
+		ripples[i].v = this->allDrop[i].point.y;
+		ripples[i].time = this->allDrop[i].time;
+		ripples[i].radius = this->allDrop[i].radius;
+		ripples[i].keepTime = this->allDrop[i].keepTime;
 	}
+	this->waterSurface.setRipples(ripples.empty() ? nullptr : &ripples[0], (int)ripples.size(), time);
+}
 
-	//if (!this->sineWaveTexture)
-	//	this->sineWaveTexture = new Texture2D(PROJECT_DIR "/Images/tiles.jpg");
+unsigned int TrainView::
+heightMapFrameCount() const
+{
+	if (this->heightMapStream)
+		return this->heightMapStream->frameCount();
+	if (this->heightMapTexture)
+		return (unsigned int)this->heightMapTexture->layers;
+	return 0;
 }
 
 void TrainView::
 initPlaneShader()
 {
-	this->planeShader = new Shader{ PROJECT_DIR "/src/shaders/simple.vert",
-										nullptr, nullptr, nullptr,
-										PROJECT_DIR "/src/shaders/simple.frag" };
-
 	GLfloat vertices[] = {
 		//down
 		-1.0f, 2.0f, 1.0f,
@@ -1276,33 +1453,15 @@ initPlaneShader()
 	glBindVertexArray(0);
 
 	if (!this->planeTexture)
-		this->planeTexture = new Texture2D(PROJECT_DIR "/Images/tiles.jpg");
+		this->assets->upload(PROJECT_DIR "/Images/tiles.jpg", [this](const cv::Mat& img) {
+			this->planeTexture = new Texture2D(img);
+		});
 }
 
 void TrainView::
 drawSkyBox(bool reflection)
 {
-	glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-	skyboxShader->Use();
-	glUniform1i(glGetUniformLocation(this->skyboxShader->Program, "skybox"), 0);
-	glm::mat4 view;
-	glm::mat4 projection;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection[0][0]);
-	view = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
-	
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->skyboxShader->Program, "view"), 1, GL_FALSE, &view[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->skyboxShader->Program, "projection"), 1, GL_FALSE, &projection[0][0]);
-
-	// skybox cube
-	glBindVertexArray(skyboxVAO);
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-	glDrawArrays(GL_TRIANGLES, 0, 36);
-	glBindVertexArray(0);
-	glDepthFunc(GL_LESS); // set depth function back to default
+	::drawSkyBox(*this->skyboxShader, this->skyboxVAO, this->cubemapTexture);
 }
 
 void TrainView::
@@ -1317,24 +1476,11 @@ drawTiles(glm::vec4 plane, bool reflection)
 	//if (reflection)
 	//	model_matrix = glm::scale(model_matrix, glm::vec3(1, 1, 1));
 
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->tilesShader->Program, "view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->tilesShader->Program, "projection"), 1, GL_FALSE, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->tilesShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->tilesShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
+	this->tilesShader->setMat4("u_model", model_matrix);
+	this->tilesShader->setVec3("u_color", glm::vec3(0.0f, 1.0f, 0.0f));
 	this->tilesTexture->bind(0);
-	glUniform1i(glGetUniformLocation(this->tilesShader->Program, "u_texture"), 0);
-	glUniform4fv(glGetUniformLocation(this->tilesShader->Program, "plane"), 1, &plane[0]);
+	this->tilesShader->setInt("u_texture", 0);
+	this->tilesShader->setVec4("plane", plane);
 
 	//bind VAO
 	glBindVertexArray(this->tiles->vao);
@@ -1351,157 +1497,66 @@ drawTiles(glm::vec4 plane, bool reflection)
 void TrainView::
 drawSineWave(bool reflection)
 {
-	glEnable(GL_BLEND);
-
-	this->sineWaveShader->Use();
-
-	glm::mat4 model_matrix = glm::mat4();
-	model_matrix = glm::translate(model_matrix, this->source_pos);
-	model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 100.0f, 100.0f));
-
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->sineWaveShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->sineWaveShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
-
-	glUniform1f(glGetUniformLocation(this->sineWaveShader->Program, ("amplitude")), tw->amplitude->value());
-	glUniform1f(glGetUniformLocation(this->sineWaveShader->Program, ("wavelength")), tw->waveLength->value());
-	glUniform1f(glGetUniformLocation(this->sineWaveShader->Program, ("speed")), 1.0f);
-	glUniform1f(glGetUniformLocation(this->sineWaveShader->Program, ("time")), t_time);
-	//this->sineWaveTexture->bind(0);
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "u_texture"), 0);
-
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-	glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "skybox"), 0);
-
-	this->tilesTexture->bind(1);
-	glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "tiles"), 1);
-
-
-	//glActiveTexture(GL_TEXTURE1);
-	//glBindTexture(GL_TEXTURE_2D, this->waterFrameBuffers->getReflectionTexture());
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "reflectionTexture"), 1);
-	//
-	//glActiveTexture(GL_TEXTURE2);
-	//glBindTexture(GL_TEXTURE_2D, this->waterFrameBuffers->getRefractionTexture());
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "refractionTexture"), 2);
-	//
-	//glActiveTexture(GL_TEXTURE3);
-	//glBindTexture(GL_TEXTURE_2D, this->waterFrameBuffers->getRefractionDepthTexture());
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "depthMap"), 3);
-
-	//this->dudvTexture->bind(4);
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "dudvMap"), 4);
-	//
-	//this->normalMap->bind(5);
-	//glUniform1i(glGetUniformLocation(this->sineWaveShader->Program, "normalMap"), 5);
+	WaterFeatures features = this->waterFeatures(reflection);
+	this->sineWaveShader = this->waterVariants->get(features);
 
 	this->moveFactor += this->WAVE_SPEED * t_time;
 	this->moveFactor /= 1.0f;
-	glUniform1f(glGetUniformLocation(this->sineWaveShader->Program, "moveFactor"), moveFactor);
-
-	GLfloat* view_matrix = new GLfloat[16];
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
-
-	view_matrix = inverse(view_matrix);
-
-	this->cameraPosition = glm::vec3(view_matrix[12], view_matrix[13], view_matrix[14]);
-	glUniform3fv(glGetUniformLocation(this->sineWaveShader->Program, "cameraPos"), 1, &glm::vec3(cameraPosition)[0]);
-
-	this->lightColor = glm::vec3(0.5f, 0.5f, 0.1f);
-	glUniform3fv(glGetUniformLocation(this->sineWaveShader->Program, "lightColor"), 1, &glm::vec3(lightColor)[0]);
 
-	this->lightPosition = glm::vec3(50.0f, 200.0f, 50.0f);
-	glUniform3fv(glGetUniformLocation(this->sineWaveShader->Program, "lightPosition"), 1, &glm::vec3(lightPosition)[0]);
-
-	//bind VAO
-	glBindVertexArray(this->sineWave->vao);
-
-	glDrawElements(GL_TRIANGLES, this->sineWave->element_amount, GL_UNSIGNED_INT, 0);
-
-	//unbind VAO
-	glBindVertexArray(0);
-
-	//unbind shader(switch to fixed pipeline)
-	glUseProgram(0);
-
-	glDisable(GL_BLEND);
+	WaterInputs inputs = this->waterInputs();
+	inputs.moveFactor = this->moveFactor;
+	drawWater(*this->sineWaveShader, features, inputs);
 }
 
 void TrainView::
-drawHeightMapWave()
+drawHeightMapWave(bool reflection)
 {
-	glEnable(GL_BLEND);
-
-	this->heightMapShader->Use();
-
-	glm::mat4 model_matrix = glm::mat4();
-	model_matrix = glm::translate(model_matrix, this->source_pos);
-	model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 100.0f, 100.0f));
-
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->heightMapShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->sineWaveShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
-
-	heightMapTexture[heightMapIndex].bind(0);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "u_texture"), 0);
-	this->tilesTexture->bind(1);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "tiles"), 1);
-	
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_CUBE_MAP, this->cubemapTexture);
-	glUniform1i(glGetUniformLocation(this->heightMapShader->Program, "skyBox"), 0);
-
-	glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "amplitude"), tw->amplitude->value());
-	glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "wavelength"), tw->waveLength->value());
-	
-	glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "time"), t_time);
-
-	GLfloat* view_matrix = new GLfloat[16];
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, view_matrix);
-
-	view_matrix = inverse(view_matrix);
-
-	this->cameraPosition = glm::vec3(view_matrix[12], view_matrix[13], view_matrix[14]);
-	glUniform3fv(glGetUniformLocation(this->heightMapShader->Program, "camera"), 1, &cameraPosition[0]);
-
-	//bind VAO
-	glBindVertexArray(this->heightMap->vao);
-
-	glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
-
-	//draw drops
-	for (int i = 0; i < allDrop.size(); ++i)
+	WaterFeatures features = this->waterFeatures(reflection);
+	this->heightMapShader = this->waterVariants->get(features);
+
+	WaterInputs inputs = this->waterInputs();
+	if (features.waveModel == WaterFeatures::WAVE_RIPPLES && features.normalMap)
+		inputs.gpuSolver = this->gpuWaveSolver;
+	else if (features.waveModel == WaterFeatures::WAVE_RIPPLES)
+		inputs.heights = this->waveHeightTexture;
+	else if (features.waveModel == WaterFeatures::WAVE_OCEAN)
+		inputs.heights = this->oceanHeightTexture;
+	else
 	{
-		if (t_time - allDrop[i].time > allDrop[i].keepTime)
-		{
-			allDrop.erase(allDrop.begin() + i);
-			--i;
-			continue;
-		}
-	
-		glUniform2f(glGetUniformLocation(this->heightMapShader->Program, "dropPoint"), allDrop[i].point.x, allDrop[i].point.y);
-		glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "dropTime"), allDrop[i].time);
-		glUniform1f(glGetUniformLocation(this->heightMapShader->Program, "interactiveRadius"), allDrop[i].radius);
-	
-		glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
-	}	
-
-	//unbind VAO
-	glBindVertexArray(0);	
+		inputs.heights = this->heightMapTexture;
+		inputs.layer = this->heightMapLayer;
+	}
+	drawWater(*this->heightMapShader, features, inputs);
+}
 
-	//unbind shader(switch to fixed pipeline)
-	glUseProgram(0);
+WaterInputs TrainView::
+waterInputs() const
+{
+	WaterInputs inputs;
+	inputs.position = this->source_pos;
+	inputs.amplitude = (float)tw->amplitude->value();
+	inputs.wavelength = (float)tw->waveLength->value();
+	inputs.grid = this->waterGrid;
+	inputs.cubemap = this->cubemapTexture;
+	inputs.tiles = this->tilesTexture;
+	if (this->waterFrameBuffers)
+		inputs.reflection = this->waterFrameBuffers->getReflectionTexture();
+	return inputs;
+}
 
-	glDisable(GL_BLEND);
+WaterFeatures TrainView::
+waterFeatures(bool reflection) const
+{
+	WaterFeatures features;
+	features.waveModel = tw->waveBrowser->value();
+	features.drops = !this->allDrop.empty();
+	// the reflection pass renders the target, it cannot sample it too
+	features.reflection = this->planarReflection && !reflection ?
+		WaterFeatures::REFLECTION_PLANAR : WaterFeatures::REFLECTION_SKYBOX;
+	features.quality = this->waterQuality;
+	// the GPU solver makes slopes along with the heights
+	features.normalMap = features.waveModel == WaterFeatures::WAVE_RIPPLES && this->useGpuWaves();
+	return features;
 }
 
 void TrainView::
@@ -1514,24 +1569,17 @@ addDrop(float radius, float keepTime)
 
 	interactiveFrameShader->Use();
 
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->interactiveFrameShader->Program, "view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->interactiveFrameShader->Program, "projection"), 1, GL_FALSE, &projection_matrix[0][0]);
+	this->interactiveFrameShader->setMat4("view", this->camera.view);
+	this->interactiveFrameShader->setMat4("projection", this->camera.projection);
 
 	glm::mat4 model_matrix = glm::mat4(1.0f);
 	model_matrix = glm::translate(model_matrix, glm::vec3(0.0f, 0.0f, 0.0f));
 	model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 100.0f, 100.0f));
 
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->interactiveFrameShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
+	this->interactiveFrameShader->setMat4("u_model", model_matrix);
 
-	glBindVertexArray(this->heightMap->vao);
-	glDrawElements(GL_TRIANGLES, this->heightMap->element_amount, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(this->waterGrid->vao);
+	glDrawElements(GL_TRIANGLES, this->waterGrid->element_amount, this->waterGrid->element_type, 0);
 	glBindVertexArray(0);
 
 	glReadBuffer(GL_COLOR_ATTACHMENT0);
@@ -1541,8 +1589,33 @@ addDrop(float radius, float keepTime)
 	glReadBuffer(GL_NONE);
 	glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
 
+	// a blue of 1 means the mouse is not over the water
 	if (uv.b != 1.0f)
+		addDropAt(glm::vec2(uv.x, uv.y), radius, keepTime);
+}
+
+void TrainView::
+addDropAt(glm::vec2 uv, float radius, float keepTime)
+{
+	if (tw->waveBrowser->value() == 3)
+	{
+		// the solver carries the ripple from here on
+		if (this->useGpuWaves())
+			addRippleDrop(*this->gpuWaveSolver, uv, radius);
+		else
+			addRippleDrop(*this->waveSolver, uv, radius);
+	}
+	else
+	{
+		if (allDrop.size() >= std::min(dropCapacity, (unsigned int)MAX_DROP_AMOUNT))
+		{
+			if (dropOverflow == DROP_IGNORE_NEWEST || allDrop.empty())
+				return;
+			// drops are appended in time order, so the front is the oldest
+			allDrop.erase(allDrop.begin());
+		}
 		allDrop.push_back(Drop(glm::vec2(uv.x, uv.y), this->t_time, radius, keepTime));
+	}
 }
 
 void TrainView::
@@ -1554,21 +1627,8 @@ drawPlane()
 	model_matrix = glm::translate(model_matrix, this->source_pos);
 	model_matrix = glm::scale(model_matrix, glm::vec3(100.0f, 100.0f, 100.0f));
 
-	glm::mat4 view_matrix;
-	glm::mat4 projection_matrix;
-
-	glGetFloatv(GL_MODELVIEW_MATRIX, &view_matrix[0][0]);
-	glGetFloatv(GL_PROJECTION_MATRIX, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(glGetUniformLocation(this->planeShader->Program, "view"), 1, GL_FALSE, &view_matrix[0][0]);
-	glUniformMatrix4fv(glGetUniformLocation(this->planeShader->Program, "projection"), 1, GL_FALSE, &projection_matrix[0][0]);
-
-	glUniformMatrix4fv(
-		glGetUniformLocation(this->planeShader->Program, "u_model"), 1, GL_FALSE, &model_matrix[0][0]);
-	glUniform3fv(
-		glGetUniformLocation(this->planeShader->Program, "u_color"),
-		1,
-		&glm::vec3(0.0f, 1.0f, 0.0f)[0]);
+	this->planeShader->setMat4("u_model", model_matrix);
+	this->planeShader->setVec3("u_color", glm::vec3(0.0f, 1.0f, 0.0f));
 
 	//this->planeTexture->bind(0);
 	//glUniform1i(glGetUniformLocation(this->planeShader->Program, "u_texture"), 0);
@@ -1576,7 +1636,7 @@ drawPlane()
 
 	glActiveTexture(GL_TEXTURE0);
 	glBindTexture(GL_TEXTURE_2D, this->waterFrameBuffers->getReflectionTexture());
-	glUniform1i(glGetUniformLocation(this->planeShader->Program, "u_texture"), 0);
+	this->planeShader->setInt("u_texture", 0);
 
 	//bind VAO
 	glBindVertexArray(this->n_plane->vao);
@@ -1590,135 +1650,60 @@ drawPlane()
 	glUseProgram(0);
 }
 
-GLfloat* TrainView::
-inverse(GLfloat* m)
+void TrainView::
+drawProfilerOverlay()
 {
-	GLfloat* inv = new GLfloat[16]();
-	float det;
-
-	int i;
-
-	inv[0] = m[5] * m[10] * m[15] -
-		m[5] * m[11] * m[14] -
-		m[9] * m[6] * m[15] +
-		m[9] * m[7] * m[14] +
-		m[13] * m[6] * m[11] -
-		m[13] * m[7] * m[10];
-
-	inv[4] = -m[4] * m[10] * m[15] +
-		m[4] * m[11] * m[14] +
-		m[8] * m[6] * m[15] -
-		m[8] * m[7] * m[14] -
-		m[12] * m[6] * m[11] +
-		m[12] * m[7] * m[10];
-
-	inv[8] = m[4] * m[9] * m[15] -
-		m[4] * m[11] * m[13] -
-		m[8] * m[5] * m[15] +
-		m[8] * m[7] * m[13] +
-		m[12] * m[5] * m[11] -
-		m[12] * m[7] * m[9];
-
-	inv[12] = -m[4] * m[9] * m[14] +
-		m[4] * m[10] * m[13] +
-		m[8] * m[5] * m[14] -
-		m[8] * m[6] * m[13] -
-		m[12] * m[5] * m[10] +
-		m[12] * m[6] * m[9];
-
-	inv[1] = -m[1] * m[10] * m[15] +
-		m[1] * m[11] * m[14] +
-		m[9] * m[2] * m[15] -
-		m[9] * m[3] * m[14] -
-		m[13] * m[2] * m[11] +
-		m[13] * m[3] * m[10];
-
-	inv[5] = m[0] * m[10] * m[15] -
-		m[0] * m[11] * m[14] -
-		m[8] * m[2] * m[15] +
-		m[8] * m[3] * m[14] +
-		m[12] * m[2] * m[11] -
-		m[12] * m[3] * m[10];
-
-	inv[9] = -m[0] * m[9] * m[15] +
-		m[0] * m[11] * m[13] +
-		m[8] * m[1] * m[15] -
-		m[8] * m[3] * m[13] -
-		m[12] * m[1] * m[11] +
-		m[12] * m[3] * m[9];
-
-	inv[13] = m[0] * m[9] * m[14] -
-		m[0] * m[10] * m[13] -
-		m[8] * m[1] * m[14] +
-		m[8] * m[2] * m[13] +
-		m[12] * m[1] * m[10] -
-		m[12] * m[2] * m[9];
-
-	inv[2] = m[1] * m[6] * m[15] -
-		m[1] * m[7] * m[14] -
-		m[5] * m[2] * m[15] +
-		m[5] * m[3] * m[14] +
-		m[13] * m[2] * m[7] -
-		m[13] * m[3] * m[6];
-
-	inv[6] = -m[0] * m[6] * m[15] +
-		m[0] * m[7] * m[14] +
-		m[4] * m[2] * m[15] -
-		m[4] * m[3] * m[14] -
-		m[12] * m[2] * m[7] +
-		m[12] * m[3] * m[6];
-
-	inv[10] = m[0] * m[5] * m[15] -
-		m[0] * m[7] * m[13] -
-		m[4] * m[1] * m[15] +
-		m[4] * m[3] * m[13] +
-		m[12] * m[1] * m[7] -
-		m[12] * m[3] * m[5];
-
-	inv[14] = -m[0] * m[5] * m[14] +
-		m[0] * m[6] * m[13] +
-		m[4] * m[1] * m[14] -
-		m[4] * m[2] * m[13] -
-		m[12] * m[1] * m[6] +
-		m[12] * m[2] * m[5];
-
-	inv[3] = -m[1] * m[6] * m[11] +
-		m[1] * m[7] * m[10] +
-		m[5] * m[2] * m[11] -
-		m[5] * m[3] * m[10] -
-		m[9] * m[2] * m[7] +
-		m[9] * m[3] * m[6];
-
-	inv[7] = m[0] * m[6] * m[11] -
-		m[0] * m[7] * m[10] -
-		m[4] * m[2] * m[11] +
-		m[4] * m[3] * m[10] +
-		m[8] * m[2] * m[7] -
-		m[8] * m[3] * m[6];
-
-	inv[11] = -m[0] * m[5] * m[11] +
-		m[0] * m[7] * m[9] +
-		m[4] * m[1] * m[11] -
-		m[4] * m[3] * m[9] -
-		m[8] * m[1] * m[7] +
-		m[8] * m[3] * m[5];
-
-	inv[15] = m[0] * m[5] * m[10] -
-		m[0] * m[6] * m[9] -
-		m[4] * m[1] * m[10] +
-		m[4] * m[2] * m[9] +
-		m[8] * m[1] * m[6] -
-		m[8] * m[2] * m[5];
-
-	det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
-
-	if (det == 0)
-		return false;
-
-	det = 1.0 / det;
-
-	for (i = 0; i < 16; i++)
-		inv[i] = inv[i] * det;
-
-	return inv;
+	// the mean of the last half second or so, single frames jitter too much
+	std::vector<PassTimer::Timing> timings;
+	this->passTimer.average(30, timings);
+
+	glUseProgram(0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glViewport(0, 0, pixel_w(), pixel_h());
+
+	glMatrixMode(GL_PROJECTION);
+	glLoadIdentity();
+	glOrtho(0, w(), 0, h(), -1, 1);
+	glMatrixMode(GL_MODELVIEW);
+	glLoadIdentity();
+
+	glDisable(GL_LIGHTING);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_TEXTURE_2D);
+
+	gl_font(FL_COURIER, 12);
+	int line = 14;
+	int y = h() - line;
+
+	char text[128];
+	snprintf(text, sizeof(text), "%-24s %8s %8s", "scope", "cpu ms", "gpu ms");
+	glColor3f(1.0f, 1.0f, 0.0f);
+	gl_draw(text, 8, y);
+	y -= line;
+
+	glColor3f(1.0f, 1.0f, 1.0f);
+	for (size_t i = 0; i < timings.size(); ++i)
+	{
+		// indent by depth, show only the last part of the name
+		const std::string& name = timings[i].name;
+		size_t slash = name.rfind('/');
+		std::string label = std::string(2 * timings[i].depth, ' ') +
+			(slash == std::string::npos ? name : name.substr(slash + 1));
+
+		snprintf(text, sizeof(text), "%-24s %8.3f %8.3f", label.c_str(), timings[i].cpuMs, timings[i].gpuMs);
+		gl_draw(text, 8, y);
+		y -= line;
+	}
+
+	snprintf(text, sizeof(text), "%-24s %8s %8.3f", "frame", "", this->gpuFrameMs);
+	glColor3f(1.0f, 1.0f, 0.0f);
+	gl_draw(text, 8, y);
+	y -= line;
+
+	// resolution of the water targets and the time adapt() steers it by
+	snprintf(text, sizeof(text), "water scale %.3f, %.3f ms of %.1f ms", this->waterFrameBuffers->getScale(),
+		this->waterFrameBuffers->getAverageFrameTime(), this->waterFrameBuffers->frameBudget);
+	gl_draw(text, 8, y);
+
+	glEnable(GL_DEPTH_TEST);
 }
\ No newline at end of file
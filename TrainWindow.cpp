@@ -17,7 +17,7 @@
 						for controlling	your train
 
 						This takes care of lots of things - including installing 
-						itself into the FlTk "idle" loop so that we get periodic 
+						itself into an FlTk timeout loop so that we get periodic 
 						updates (if we're running the train).
 
 
@@ -34,6 +34,7 @@
 #include "TrainWindow.H"
 #include "TrainView.H"
 #include "CallBacks.H"
+#include "Utilities/TraceRecorder.H"
 
 
 
@@ -149,6 +150,8 @@ TrainWindow(const int x, const int y)
 		waveBrowser->callback((Fl_Callback*)damageCB, this);
 		waveBrowser->add("Sine wave");
 		waveBrowser->add("Heightmap");
+		waveBrowser->add("Ripple solver");
+		waveBrowser->add("FFT ocean");
 		waveBrowser->select(1);
 
 		pty += 110;
@@ -182,8 +185,9 @@ TrainWindow(const int x, const int y)
 	}
 	end();	// done adding to this widget
 
-	// set up callback on idle
-	Fl::add_idle((void (*)(void*))runButtonCB,this);
+	// redraw renderRate times a second; the callback runs the simulation
+	// steps that are due and schedules itself again
+	Fl::add_timeout(simulationClock.renderInterval(), (Fl_Timeout_Handler)runButtonCB, this);
 }
 
 //************************************************************************
@@ -215,8 +219,8 @@ damageMe()
 
 //************************************************************************
 //
-// * This will get called (approximately) 30 times per second
-//   if the run button is pressed
+// * Run one fixed simulation step, called simulationClock.stepRate times
+//   per simulated second while the run button is pressed
 //========================================================================
 void TrainWindow::
 advanceTrain(float dir)
@@ -226,12 +230,28 @@ advanceTrain(float dir)
 	// TODO: make this work for your train
 	//#####################################################################
 
+	TraceRecorder::Scope trace("sim", "sim step");
+	float step = (float)simulationClock.stepSeconds();
+
 	if (waveBrowser->value() == 1)
-		trainView->t_time += (dir / m_Track.points.size() / (trainView->DIVIDE_LINE / 40));
+		trainView->t_time += dir * step * WAVE_TIME_RATE;
+	else if (waveBrowser->value() == 3)
+	{
+		if (trainView->useGpuWaves())
+			trainView->gpuWaveSolver->step();
+		else if (trainView->waveSolver)
+			trainView->waveSolver->step();
+	}
+	else if (waveBrowser->value() == 4)
+	{
+		trainView->oceanTime += step;
+		if (trainView->ocean)
+			trainView->ocean->update(trainView->oceanTime, TessendorfOcean::HEIGHTS);
+	}
 	else
 	{
 		trainView->heightMapIndex += 1;
-		if (trainView->heightMapIndex == 200)
+		if (trainView->heightMapIndex >= trainView->heightMapFrameCount())
 			trainView->heightMapIndex = 0;
 	}
 #ifdef EXAMPLE_SOLUTION
@@ -249,4 +269,46 @@ advanceTrain(float dir)
 	if (world.trainU > nct) world.trainU -= nct;
 	if (world.trainU < 0) world.trainU += nct;
 #endif
+}
+//************************************************************************
+//
+// * Put every wave mode back to its first frame, so a benchmark mode
+//   starts from the same state on every run
+//========================================================================
+void TrainWindow::
+resetWaves()
+//========================================================================
+{
+	trainView->t_time = 0.0f;
+	trainView->renderTimeOffset = 0.0f;
+	trainView->heightMapIndex = 0;
+	trainView->allDrop.clear();
+
+	if (trainView->waveSolver)
+		trainView->waveSolver->reset();
+	if (trainView->gpuWaveSolver)
+		trainView->gpuWaveSolver->reset();
+
+	trainView->oceanTime = 0.0f;
+	if (trainView->ocean)
+		trainView->ocean->update(trainView->oceanTime, TessendorfOcean::HEIGHTS);
+}
+
+//************************************************************************
+//
+// * Hand the frames over to a benchmark; the run button is released and
+//   the world camera selected, since the benchmark moves the arcball
+//========================================================================
+void TrainWindow::
+startBenchmark(Benchmark* b)
+//========================================================================
+{
+	benchmark = b;
+	trainView->benchmark = b;
+
+	runButton->value(0);
+	worldCam->setonly();
+
+	Fl::remove_timeout((Fl_Timeout_Handler)runButtonCB, this);
+	Fl::add_idle((Fl_Idle_Handler)benchmarkCB, this);
 }
\ No newline at end of file
@@ -68,6 +68,9 @@
 
 #include "stdio.h"
 
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
 //**************************************************************************
 //
 // * Constructor
@@ -136,6 +139,65 @@ setProjection(bool doClear)
   multMatrix();
 }
 
+//**************************************************************************
+//
+// * The modelview setProjection builds: eye translation, then the ball
+//==========================================================================
+glm::mat4 ArcBallCam::
+getViewMatrix() const
+//==========================================================================
+{
+	HMatrix m;
+	getMatrix(m);
+	return glm::translate(glm::mat4(1.0f), glm::vec3(-eyeX, -eyeY, -eyeZ)) * glm::make_mat4(&m[0][0]);
+}
+
+//**************************************************************************
+//
+// * The perspective setProjection builds
+//==========================================================================
+glm::mat4 ArcBallCam::
+getProjectionMatrix() const
+//==========================================================================
+{
+	float aspect = ((float) wind->w()) / ((float) wind->h());
+	return glm::perspective(glm::radians(fieldOfView), aspect, .1f, 1000.0f);
+}
+
+//**************************************************************************
+//
+// * The current rotation, eye and field of view
+//==========================================================================
+ArcBallCam::Pose ArcBallCam::
+getPose() const
+//==========================================================================
+{
+	Pose pose;
+	pose.rotation = now * start;
+	pose.eyeX = eyeX;
+	pose.eyeY = eyeY;
+	pose.eyeZ = eyeZ;
+	pose.fieldOfView = fieldOfView;
+	return pose;
+}
+
+//**************************************************************************
+//
+// * Jump to a pose from getPose(), drops any drag in progress
+//==========================================================================
+void ArcBallCam::
+setPose(const Pose& pose)
+//==========================================================================
+{
+	start = pose.rotation;
+	now = Quat();
+	mode = None;
+	eyeX = pose.eyeX;
+	eyeY = pose.eyeY;
+	eyeZ = pose.eyeZ;
+	fieldOfView = pose.fieldOfView;
+}
+
 //**************************************************************************
 //
 // * Handle the event happen to this camera
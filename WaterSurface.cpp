@@ -0,0 +1,628 @@
+/************************************************************************
+     File:        WaterSurface.cpp
+
+     Comment:
+						Height and normal of the drawn water on the CPU.
+						See WaterSurface.H for the overview.
+
+						The constants are the shaders'; change them
+						together. The SSE2 path evaluates four points at
+						once, with sin, cos and exp approximated to about
+						float precision; a batch whose size is not a
+						multiple of four pads its last group.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "WaterSurface.H"
+
+#include "Utilities/ThreadPool.H"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define WATER_SURFACE_SSE
+#endif
+
+// below this many points the threads cost more than they save
+static const int MIN_POINTS_FOR_THREADS = 4096;
+
+// GridMesh defaults: the water is GRID_SIZE across at GRID_HEIGHT
+static const float GRID_SIZE = 2.0f;
+static const float GRID_HEIGHT = 0.6f;
+
+// shaders/cubemaps.vert
+static const float SINE_PI = 3.14159f;
+static const float GRAVITY = 9.8f;
+static const float DIRECTION_X = 0.70710678f;	// normalize(1, 1)
+static const float DIRECTION_Z = 0.70710678f;
+// Newton steps to find the grid point the wave moved onto the query point
+static const int SINE_ITERATIONS = 4;
+// at an amplitude of 1 the crests fold over and the slope of the solve
+// reaches 0; this keeps the steps finite
+static const float MIN_SLOPE = 0.1f;
+
+// shaders/include/drops.glsl
+static const float DROP_PI = 3.14159f;
+static const float INTERACTIVE_AMPLITUDE = 0.15f;
+static const float INTERACTIVE_WAVELENGTH = 0.5f;
+static const float INTERACTIVE_SPEED = 8.0f;
+
+//************************************************************************
+//
+// * Pick between the wave and the drops the way heightMap.vert does:
+//   opposite signs add up, otherwise the larger one wins
+//========================================================================
+static float combine(float wave, float ripple)
+//========================================================================
+{
+	if ((wave < 0 && ripple > 0) || (wave > 0 && ripple < 0))
+		return wave + ripple;
+	return fabsf(wave) > fabsf(ripple) ? wave : ripple;
+}
+
+//************************************************************************
+//
+// * Normal of the Gerstner wave at phase f, from the tangent and
+//   binormal of cubemaps.vert
+//========================================================================
+static void sineNormal(float steepness, float s, float c, float* normal)
+//========================================================================
+{
+	float tx = 1.0f - DIRECTION_X * DIRECTION_X * steepness * s;
+	float ty = DIRECTION_X * steepness * c;
+	float tz = -DIRECTION_X * DIRECTION_Z * steepness * s;
+	float bx = -DIRECTION_X * DIRECTION_Z * steepness * s;
+	float by = DIRECTION_Z * steepness * c;
+	float bz = 1.0f - DIRECTION_Z * DIRECTION_Z * steepness * s;
+
+	// cross(binormal, tangent)
+	float nx = by * tz - bz * ty;
+	float ny = bz * tx - bx * tz;
+	float nz = bx * ty - by * tx;
+	float length = sqrtf(nx * nx + ny * ny + nz * nz);
+	normal[0] = nx / length;
+	normal[1] = ny / length;
+	normal[2] = nz / length;
+}
+
+#if defined(WATER_SURFACE_SSE)
+//************************************************************************
+//
+// * floor, SSE2 has no round instruction
+//========================================================================
+static inline __m128 floor4(__m128 x)
+//========================================================================
+{
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(x));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, x), _mm_set1_ps(1.0f)));
+}
+
+static inline __m128 abs4(__m128 x)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+}
+
+// mask ? a : b
+static inline __m128 select4(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+//************************************************************************
+//
+// * sin and cos: reduce to a quarter turn, then the Cephes polynomials
+//========================================================================
+static inline void sincos4(__m128 x, __m128& s, __m128& c)
+//========================================================================
+{
+	__m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977f)));
+	__m128 j = _mm_cvtepi32_ps(quadrant);
+	// pi / 2 in three parts, so the reduction keeps its precision
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(j, _mm_set1_ps(1.5703125f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(4.837512969970703125e-4f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(j, _mm_set1_ps(7.54978995489188216e-8f)));
+	__m128 z = _mm_mul_ps(r, r);
+
+	__m128 ps = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(-1.9515295891e-4f)), _mm_set1_ps(8.3321608736e-3f));
+	ps = _mm_add_ps(_mm_mul_ps(ps, z), _mm_set1_ps(-1.6666654611e-1f));
+	ps = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(ps, z), r), r);
+
+	__m128 pc = _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(2.443315711809948e-5f)), _mm_set1_ps(-1.388731625493765e-3f));
+	pc = _mm_add_ps(_mm_mul_ps(pc, z), _mm_set1_ps(4.166664568298827e-2f));
+	pc = _mm_mul_ps(_mm_mul_ps(pc, z), z);
+	pc = _mm_add_ps(_mm_sub_ps(pc, _mm_mul_ps(z, _mm_set1_ps(0.5f))), _mm_set1_ps(1.0f));
+
+	// odd quadrants swap sin and cos; the sign bits come from the quadrant
+	__m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(1)));
+	__m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, _mm_set1_epi32(2)), 30));
+	__m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(
+		_mm_and_si128(_mm_add_epi32(quadrant, _mm_set1_epi32(1)), _mm_set1_epi32(2)), 30));
+	s = _mm_xor_ps(select4(swap, pc, ps), sinSign);
+	c = _mm_xor_ps(select4(swap, ps, pc), cosSign);
+}
+
+//************************************************************************
+//
+// * exp: 2^n times the Cephes polynomial of the remainder
+//========================================================================
+static inline __m128 exp4(__m128 x)
+//========================================================================
+{
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-87.3f)), _mm_set1_ps(88.3f));
+	__m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)));
+	__m128 nf = _mm_cvtepi32_ps(n);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(0.693359375f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(-2.12194440e-4f)));
+
+	__m128 p = _mm_add_ps(_mm_mul_ps(r, _mm_set1_ps(1.9875691500e-4f)), _mm_set1_ps(1.3981999507e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(8.3334519073e-3f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(4.1665795894e-2f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.6666665459e-1f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(5.0000001201e-1f));
+	p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(p, r), r), r), _mm_set1_ps(1.0f));
+
+	__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+	return _mm_mul_ps(p, scale);
+}
+#endif
+
+//************************************************************************
+//
+// * Constructor
+//========================================================================
+WaterSurface::
+WaterSurface(unsigned int _threadCount)
+	: threadCount(_threadCount),
+	  originX(0.0f), originY(0.0f), originZ(0.0f), scale(1.0f),
+	  model(HEIGHTMAP),
+	  amplitude(0.0f), wavelength(1.0f), time(0.0f),
+	  texels(nullptr), format(FLOAT), width(1), height(1), repeat(true),
+	  bias(0.0f), fieldAmplitude(0.0f),
+	  rippleTime(0.0f)
+//========================================================================
+{
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void WaterSurface::
+setPlacement(float x, float y, float z, float _scale)
+//========================================================================
+{
+	originX = x;
+	originY = y;
+	originZ = z;
+	scale = _scale;
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void WaterSurface::
+setSine(float _amplitude, float _wavelength, float _time)
+//========================================================================
+{
+	model = SINE;
+	amplitude = _amplitude;
+	wavelength = _wavelength;
+	time = _time;
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void WaterSurface::
+setHeightField(WaveModel _model, const void* _texels, Format _format,
+			   int _width, int _height, bool _repeat, float _bias, float _amplitude)
+//========================================================================
+{
+	model = _model;
+	texels = _texels;
+	format = _format;
+	width = std::max(_width, 1);
+	height = std::max(_height, 1);
+	repeat = _repeat;
+	bias = _bias;
+	fieldAmplitude = _amplitude;
+}
+
+//************************************************************************
+//
+// * Copy the live drops, at most MAX_RIPPLES like the drops block
+//========================================================================
+void WaterSurface::
+setRipples(const Ripple* _ripples, int count, float _time)
+//========================================================================
+{
+	ripples.assign(_ripples, _ripples + std::min(std::max(count, 0), (int)MAX_RIPPLES));
+	rippleTime = _time;
+}
+
+//************************************************************************
+//
+// * Height field texel (x, y), wrapped or clamped like the texture
+//========================================================================
+float WaterSurface::
+texel(int x, int y) const
+//========================================================================
+{
+	if (repeat) {
+		x = ((x % width) + width) % width;
+		y = ((y % height) + height) % height;
+	}
+	else {
+		x = std::min(std::max(x, 0), width - 1);
+		y = std::min(std::max(y, 0), height - 1);
+	}
+	size_t i = (size_t)y * width + x;
+	if (format == UNORM8)
+		return ((const unsigned char*)texels)[i] / 255.0f;
+	if (format == UNORM16)
+		return ((const unsigned short*)texels)[i] / 65535.0f;
+	return ((const float*)texels)[i];
+}
+
+//************************************************************************
+//
+// * GL_LINEAR filtering at texture coordinate (u, v)
+//========================================================================
+float WaterSurface::
+sample(float u, float v) const
+//========================================================================
+{
+	if (!texels)
+		return bias;
+
+	float s = u * width - 0.5f;
+	float t = v * height - 0.5f;
+	float x0 = floorf(s);
+	float y0 = floorf(t);
+	float fx = s - x0;
+	float fy = t - y0;
+	int x = (int)x0, y = (int)y0;
+
+	float top = texel(x, y) + (texel(x + 1, y) - texel(x, y)) * fx;
+	float bottom = texel(x, y + 1) + (texel(x + 1, y + 1) - texel(x, y + 1)) * fx;
+	return top + (bottom - top) * fy;
+}
+
+//************************************************************************
+//
+// * dropRipples() of shaders/include/drops.glsl
+//========================================================================
+float WaterSurface::
+ripplesAt(float u, float v) const
+//========================================================================
+{
+	float sum = 0.0f;
+	for (size_t i = 0; i < ripples.size(); ++i) {
+		const Ripple& ripple = ripples[i];
+		float age = rippleTime - ripple.time;
+		if (age > ripple.keepTime)
+			continue;
+
+		float du = u - ripple.u;
+		float dv = v - ripple.v;
+		float d = sqrtf(du * du + dv * dv) / INTERACTIVE_WAVELENGTH * 100.0f;
+		float t = age * (ripple.radius * DROP_PI) * INTERACTIVE_SPEED;
+		float ramp = std::min(std::max(0.0125f * t, 0.0f), 1.0f);
+		sum += INTERACTIVE_AMPLITUDE * sinf((d - t) * ramp) / expf(0.1f * fabsf(d - t) + 0.05f * t) * 1.5f;
+	}
+	return sum;
+}
+
+//************************************************************************
+//
+// * Gerstner wave: find the grid point whose displaced position lands on
+//   (gx, gz), then its height. The displacement is along the wave
+//   direction only, so that is one Newton solve along it
+//========================================================================
+float WaterSurface::
+sineHeight(float gx, float gz, float* normal) const
+//========================================================================
+{
+	if (wavelength <= 0.0f) {
+		if (normal) {
+			normal[0] = normal[2] = 0.0f;
+			normal[1] = 1.0f;
+		}
+		return GRID_HEIGHT;
+	}
+
+	float k = 2 * SINE_PI / wavelength;
+	float c = sqrtf(GRAVITY / k);
+	float a = amplitude / k;
+
+	float target = DIRECTION_X * gx + DIRECTION_Z * gz;
+	float q = target;
+	for (int i = 0; i < SINE_ITERATIONS; ++i) {
+		float f = k * (q - c * time);
+		q -= (q + a * cosf(f) - target) / std::max(1.0f - amplitude * sinf(f), MIN_SLOPE);
+	}
+
+	float f = k * (q - c * time);
+	float s = sinf(f);
+	if (normal)
+		sineNormal(amplitude, s, cosf(f), normal);
+	return GRID_HEIGHT + a * s;
+}
+
+//************************************************************************
+//
+// * Water height at grid point (gx, gz), in object space
+//========================================================================
+float WaterSurface::
+objectHeight(float gx, float gz) const
+//========================================================================
+{
+	if (model == SINE)
+		return sineHeight(gx, gz, nullptr);
+
+	float u = gx / GRID_SIZE + 0.5f;
+	float v = gz / GRID_SIZE + 0.5f;
+	float wave = (sample(u, v) - bias) * fieldAmplitude;
+	return GRID_HEIGHT + (ripples.empty() ? wave : combine(wave, ripplesAt(u, v)));
+}
+
+//************************************************************************
+//
+// * Normal from central differences one texel apart; the scale of the
+//   model matrix is uniform, so object and world normals agree
+//========================================================================
+void WaterSurface::
+objectNormal(float gx, float gz, float* normal) const
+//========================================================================
+{
+	if (model == SINE) {
+		sineHeight(gx, gz, normal);
+		return;
+	}
+
+	float e = GRID_SIZE / width;
+	float dx = (objectHeight(gx + e, gz) - objectHeight(gx - e, gz)) / (2.0f * e);
+	float dz = (objectHeight(gx, gz + e) - objectHeight(gx, gz - e)) / (2.0f * e);
+	float length = sqrtf(dx * dx + dz * dz + 1.0f);
+	normal[0] = -dx / length;
+	normal[1] = 1.0f / length;
+	normal[2] = -dz / length;
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+void WaterSurface::
+queryReference(const float* x, const float* z, int count, float* heights, float* normals) const
+//========================================================================
+{
+	for (int i = 0; i < count; ++i) {
+		float gx = (x[i] - originX) / scale;
+		float gz = (z[i] - originZ) / scale;
+		heights[i] = originY + scale * objectHeight(gx, gz);
+		if (normals)
+			objectNormal(gx, gz, normals + 3 * i);
+	}
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+float WaterSurface::
+heightAt(float x, float z) const
+//========================================================================
+{
+	float h;
+	queryReference(&x, &z, 1, &h);
+	return h;
+}
+
+//************************************************************************
+//
+// * Split the batch over the pool, in groups of four points
+//========================================================================
+void WaterSurface::
+query(const float* x, const float* z, int count, float* heights, float* normals) const
+//========================================================================
+{
+#if defined(WATER_SURFACE_SSE)
+	if (count < MIN_POINTS_FOR_THREADS) {
+		queryRange(x, z, 0, count, heights, normals);
+		return;
+	}
+	int groups = (count + 3) / 4;
+	ThreadPool::shared().parallelFor(groups,
+		[this, x, z, count, heights, normals](int begin, int end) {
+			queryRange(x, z, begin * 4, std::min(end * 4, count), heights, normals);
+		},
+		threadCount);
+#else
+	queryReference(x, z, count, heights, normals);
+#endif
+}
+
+#if defined(WATER_SURFACE_SSE)
+//************************************************************************
+//
+// * Four points at a time; a short last group is padded with copies of
+//   its last point
+//========================================================================
+void WaterSurface::
+queryRange(const float* x, const float* z, int begin, int end, float* heights, float* normals) const
+//========================================================================
+{
+	int i = begin;
+	for (; i + 4 <= end; i += 4)
+		query4(x + i, z + i, heights + i, normals ? normals + 3 * i : nullptr);
+	if (i == end)
+		return;
+
+	int left = end - i;
+	float px[4], pz[4], ph[4], pn[12];
+	for (int j = 0; j < 4; ++j) {
+		px[j] = x[i + std::min(j, left - 1)];
+		pz[j] = z[i + std::min(j, left - 1)];
+	}
+	query4(px, pz, ph, normals ? pn : nullptr);
+	std::copy(ph, ph + left, heights + i);
+	if (normals)
+		std::copy(pn, pn + 3 * left, normals + 3 * i);
+}
+
+//************************************************************************
+//
+// * The water at four points, the vector form of objectHeight() and
+//   objectNormal()
+//========================================================================
+void WaterSurface::
+query4(const float* x, const float* z, float* heights, float* normals) const
+//========================================================================
+{
+	const __m128 one = _mm_set1_ps(1.0f);
+	__m128 inverseScale = _mm_set1_ps(1.0f / scale);
+	__m128 gx = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(x), _mm_set1_ps(originX)), inverseScale);
+	__m128 gz = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(z), _mm_set1_ps(originZ)), inverseScale);
+	__m128 y;
+	__m128 nx, ny, nz;
+
+	if (model == SINE && wavelength > 0.0f) {
+		float k = 2 * SINE_PI / wavelength;
+		float c = sqrtf(GRAVITY / k);
+		__m128 vk = _mm_set1_ps(k);
+		__m128 phase = _mm_set1_ps(c * time);
+		__m128 va = _mm_set1_ps(amplitude / k);
+		__m128 steepness = _mm_set1_ps(amplitude);
+
+		__m128 target = _mm_add_ps(_mm_mul_ps(gx, _mm_set1_ps(DIRECTION_X)), _mm_mul_ps(gz, _mm_set1_ps(DIRECTION_Z)));
+		__m128 q = target;
+		__m128 s, co;
+		for (int i = 0; i < SINE_ITERATIONS; ++i) {
+			sincos4(_mm_mul_ps(vk, _mm_sub_ps(q, phase)), s, co);
+			__m128 g = _mm_sub_ps(_mm_add_ps(q, _mm_mul_ps(va, co)), target);
+			q = _mm_sub_ps(q, _mm_div_ps(g, _mm_max_ps(_mm_sub_ps(one, _mm_mul_ps(steepness, s)), _mm_set1_ps(MIN_SLOPE))));
+		}
+		sincos4(_mm_mul_ps(vk, _mm_sub_ps(q, phase)), s, co);
+		y = _mm_add_ps(_mm_set1_ps(GRID_HEIGHT), _mm_mul_ps(va, s));
+
+		if (normals) {
+			__m128 ss = _mm_mul_ps(steepness, s);
+			__m128 sc = _mm_mul_ps(steepness, co);
+			__m128 tx = _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(DIRECTION_X * DIRECTION_X), ss));
+			__m128 ty = _mm_mul_ps(_mm_set1_ps(DIRECTION_X), sc);
+			__m128 tz = _mm_mul_ps(_mm_set1_ps(-DIRECTION_X * DIRECTION_Z), ss);
+			__m128 bx = tz;
+			__m128 by = _mm_mul_ps(_mm_set1_ps(DIRECTION_Z), sc);
+			__m128 bz = _mm_sub_ps(one, _mm_mul_ps(_mm_set1_ps(DIRECTION_Z * DIRECTION_Z), ss));
+			nx = _mm_sub_ps(_mm_mul_ps(by, tz), _mm_mul_ps(bz, ty));
+			ny = _mm_sub_ps(_mm_mul_ps(bz, tx), _mm_mul_ps(bx, tz));
+			nz = _mm_sub_ps(_mm_mul_ps(bx, ty), _mm_mul_ps(by, tx));
+		}
+	}
+	else if (model == SINE) {
+		y = _mm_set1_ps(GRID_HEIGHT);
+		nx = nz = _mm_setzero_ps();
+		ny = one;
+	}
+	else {
+		// the height field and the drops at four grid points
+		auto fieldHeight = [this](__m128 px, __m128 pz) -> __m128 {
+			__m128 u = _mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(1.0f / GRID_SIZE)), _mm_set1_ps(0.5f));
+			__m128 v = _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(1.0f / GRID_SIZE)), _mm_set1_ps(0.5f));
+
+			__m128 wave = _mm_setzero_ps();
+			if (texels) {
+				__m128 s = _mm_sub_ps(_mm_mul_ps(u, _mm_set1_ps((float)width)), _mm_set1_ps(0.5f));
+				__m128 t = _mm_sub_ps(_mm_mul_ps(v, _mm_set1_ps((float)height)), _mm_set1_ps(0.5f));
+				__m128 x0 = floor4(s);
+				__m128 y0 = floor4(t);
+				__m128 fx = _mm_sub_ps(s, x0);
+				__m128 fy = _mm_sub_ps(t, y0);
+
+				// the texels are gathered one lane at a time
+				alignas(16) int ix[4], iy[4];
+				alignas(16) float t00[4], t10[4], t01[4], t11[4];
+				_mm_store_si128((__m128i*)ix, _mm_cvttps_epi32(x0));
+				_mm_store_si128((__m128i*)iy, _mm_cvttps_epi32(y0));
+				for (int j = 0; j < 4; ++j) {
+					t00[j] = texel(ix[j], iy[j]);
+					t10[j] = texel(ix[j] + 1, iy[j]);
+					t01[j] = texel(ix[j], iy[j] + 1);
+					t11[j] = texel(ix[j] + 1, iy[j] + 1);
+				}
+				__m128 a = _mm_load_ps(t00), b = _mm_load_ps(t10);
+				__m128 top = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx));
+				a = _mm_load_ps(t01);
+				b = _mm_load_ps(t11);
+				__m128 bottom = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), fx));
+				__m128 filtered = _mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), fy));
+				wave = _mm_mul_ps(_mm_sub_ps(filtered, _mm_set1_ps(bias)), _mm_set1_ps(fieldAmplitude));
+			}
+			if (ripples.empty())
+				return _mm_add_ps(_mm_set1_ps(GRID_HEIGHT), wave);
+
+			__m128 sum = _mm_setzero_ps();
+			for (size_t i = 0; i < ripples.size(); ++i) {
+				const Ripple& ripple = ripples[i];
+				float age = rippleTime - ripple.time;
+				if (age > ripple.keepTime)
+					continue;
+				float t = age * (ripple.radius * DROP_PI) * INTERACTIVE_SPEED;
+				float ramp = std::min(std::max(0.0125f * t, 0.0f), 1.0f);
+
+				__m128 du = _mm_sub_ps(u, _mm_set1_ps(ripple.u));
+				__m128 dv = _mm_sub_ps(v, _mm_set1_ps(ripple.v));
+				__m128 d = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(du, du), _mm_mul_ps(dv, dv)));
+				d = _mm_mul_ps(_mm_div_ps(d, _mm_set1_ps(INTERACTIVE_WAVELENGTH)), _mm_set1_ps(100.0f));
+				__m128 front = _mm_sub_ps(d, _mm_set1_ps(t));
+				__m128 s, c;
+				sincos4(_mm_mul_ps(front, _mm_set1_ps(ramp)), s, c);
+				__m128 fade = exp4(_mm_add_ps(_mm_mul_ps(abs4(front), _mm_set1_ps(0.1f)), _mm_set1_ps(0.05f * t)));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_div_ps(_mm_mul_ps(_mm_set1_ps(INTERACTIVE_AMPLITUDE), s), fade),
+												 _mm_set1_ps(1.5f)));
+			}
+
+			// combine(): opposite signs add up, otherwise the larger wins
+			__m128 zero = _mm_setzero_ps();
+			__m128 opposite = _mm_or_ps(_mm_and_ps(_mm_cmplt_ps(wave, zero), _mm_cmpgt_ps(sum, zero)),
+										_mm_and_ps(_mm_cmpgt_ps(wave, zero), _mm_cmplt_ps(sum, zero)));
+			__m128 larger = select4(_mm_cmpgt_ps(abs4(wave), abs4(sum)), wave, sum);
+			return _mm_add_ps(_mm_set1_ps(GRID_HEIGHT), select4(opposite, _mm_add_ps(wave, sum), larger));
+		};
+
+		y = fieldHeight(gx, gz);
+		if (normals) {
+			float e = GRID_SIZE / width;
+			__m128 ve = _mm_set1_ps(e);
+			__m128 inverseStep = _mm_set1_ps(1.0f / (2.0f * e));
+			__m128 dx = _mm_mul_ps(_mm_sub_ps(fieldHeight(_mm_add_ps(gx, ve), gz), fieldHeight(_mm_sub_ps(gx, ve), gz)), inverseStep);
+			__m128 dz = _mm_mul_ps(_mm_sub_ps(fieldHeight(gx, _mm_add_ps(gz, ve)), fieldHeight(gx, _mm_sub_ps(gz, ve))), inverseStep);
+			nx = _mm_sub_ps(_mm_setzero_ps(), dx);
+			ny = one;
+			nz = _mm_sub_ps(_mm_setzero_ps(), dz);
+		}
+	}
+
+	_mm_storeu_ps(heights, _mm_add_ps(_mm_set1_ps(originY), _mm_mul_ps(_mm_set1_ps(scale), y)));
+	if (!normals)
+		return;
+
+	__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, nx), _mm_mul_ps(ny, ny)), _mm_mul_ps(nz, nz)));
+	alignas(16) float ox[4], oy[4], oz[4];
+	_mm_store_ps(ox, _mm_div_ps(nx, length));
+	_mm_store_ps(oy, _mm_div_ps(ny, length));
+	_mm_store_ps(oz, _mm_div_ps(nz, length));
+	for (int j = 0; j < 4; ++j) {
+		normals[3 * j] = ox[j];
+		normals[3 * j + 1] = oy[j];
+		normals[3 * j + 2] = oz[j];
+	}
+}
+#endif
@@ -0,0 +1,235 @@
+/************************************************************************
+     File:        WaveSolver.cpp
+
+     Comment:
+						Discrete 2D wave equation on a height field.
+						See WaveSolver.H for the overview.
+
+						The step kernel works on whole rows. It uses AVX
+						when the compiler targets it, SSE2 otherwise, and
+						falls back to plain C++ for the row tails. The rows
+						are split into bands that run on the shared
+						ThreadPool.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include "WaveSolver.H"
+
+#include "Utilities/ThreadPool.H"
+
+#include <algorithm>
+#include <math.h>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define WAVE_SOLVER_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define WAVE_SOLVER_SSE
+#endif
+
+// below this many cells the threads cost more than they save
+static const int MIN_CELLS_FOR_THREADS = 64 * 64;
+
+//************************************************************************
+//
+// * advance one row of cells
+//   up/row/down point at the first interior cell of three adjacent rows
+//   the scalar tail does the operations in the same order as the SIMD
+//   paths so every path produces the same numbers
+//========================================================================
+static void stepRow(const float* up, const float* row, const float* down,
+					const float* vel, float* rowOut, float* velOut,
+					int count, float c, float d, bool simd)
+//========================================================================
+{
+	// without simd the whole row goes through the scalar loop
+	int i = 0;
+#if defined(WAVE_SOLVER_AVX)
+	const __m256 vc = _mm256_set1_ps(c);
+	const __m256 vd = _mm256_set1_ps(d);
+	const __m256 four = _mm256_set1_ps(4.0f);
+	for (; simd && i + 8 <= count; i += 8) {
+		__m256 h = _mm256_loadu_ps(row + i);
+		__m256 sum = _mm256_add_ps(
+			_mm256_add_ps(_mm256_loadu_ps(row + i - 1), _mm256_loadu_ps(row + i + 1)),
+			_mm256_add_ps(_mm256_loadu_ps(up + i), _mm256_loadu_ps(down + i)));
+		__m256 lap = _mm256_sub_ps(sum, _mm256_mul_ps(four, h));
+		__m256 v = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(vel + i), _mm256_mul_ps(vc, lap)), vd);
+		_mm256_storeu_ps(velOut + i, v);
+		_mm256_storeu_ps(rowOut + i, _mm256_add_ps(h, v));
+	}
+#elif defined(WAVE_SOLVER_SSE)
+	const __m128 vc = _mm_set1_ps(c);
+	const __m128 vd = _mm_set1_ps(d);
+	const __m128 four = _mm_set1_ps(4.0f);
+	for (; simd && i + 4 <= count; i += 4) {
+		__m128 h = _mm_loadu_ps(row + i);
+		__m128 sum = _mm_add_ps(
+			_mm_add_ps(_mm_loadu_ps(row + i - 1), _mm_loadu_ps(row + i + 1)),
+			_mm_add_ps(_mm_loadu_ps(up + i), _mm_loadu_ps(down + i)));
+		__m128 lap = _mm_sub_ps(sum, _mm_mul_ps(four, h));
+		__m128 v = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(vel + i), _mm_mul_ps(vc, lap)), vd);
+		_mm_storeu_ps(velOut + i, v);
+		_mm_storeu_ps(rowOut + i, _mm_add_ps(h, v));
+	}
+#endif
+	for (; i < count; ++i) {
+		float h = row[i];
+		float sum = (row[i - 1] + row[i + 1]) + (up[i] + down[i]);
+		float lap = sum - 4.0f * h;
+		float v = (vel[i] + c * lap) * d;
+		velOut[i] = v;
+		rowOut[i] = h + v;
+	}
+}
+
+//************************************************************************
+//
+// * Constructor
+//========================================================================
+WaveSolver::
+WaveSolver(int _width, int _height, unsigned int _threadCount)
+	: stiffness(0.5f), damping(0.995f), vectorized(true),
+	  width(_width), height(_height), threadCount(_threadCount), current(0)
+//========================================================================
+{
+	// one ghost cell on each side, rows padded to a multiple of 8 floats
+	stride = (width + 2 + 7) & ~7;
+
+	reset();
+}
+
+//************************************************************************
+//
+// * Flatten the water
+//========================================================================
+void WaveSolver::
+reset()
+//========================================================================
+{
+	size_t cells = (size_t)stride * (height + 2);
+	for (int i = 0; i < 2; ++i) {
+		heights[i].assign(cells, 0.0f);
+		velocities[i].assign(cells, 0.0f);
+	}
+	current = 0;
+}
+
+//************************************************************************
+//
+// * Copy the border into the ghost ring so the walls reflect
+//========================================================================
+void WaveSolver::
+reflectBorders(std::vector<float>& grid)
+//========================================================================
+{
+	for (int y = 0; y < height; ++y) {
+		grid[index(-1, y)] = grid[index(0, y)];
+		grid[index(width, y)] = grid[index(width - 1, y)];
+	}
+	std::copy(grid.begin() + index(-1, 0), grid.begin() + index(-1, 0) + stride,
+			  grid.begin() + index(-1, -1));
+	std::copy(grid.begin() + index(-1, height - 1), grid.begin() + index(-1, height - 1) + stride,
+			  grid.begin() + index(-1, height));
+}
+
+//************************************************************************
+//
+// * Advance a band of rows from the current buffer into the other one
+//========================================================================
+void WaveSolver::
+stepRows(int rowBegin, int rowEnd, float c, float d, bool simd)
+//========================================================================
+{
+	const std::vector<float>& h = heights[current];
+	const std::vector<float>& v = velocities[current];
+	std::vector<float>& hOut = heights[current ^ 1];
+	std::vector<float>& vOut = velocities[current ^ 1];
+
+	for (int y = rowBegin; y < rowEnd; ++y) {
+		int i = index(0, y);
+		stepRow(&h[i - stride], &h[i], &h[i + stride], &v[i], &hOut[i], &vOut[i], width, c, d, simd);
+	}
+}
+
+//************************************************************************
+//
+// * Advance the whole grid by one tick
+//========================================================================
+void WaveSolver::
+step()
+//========================================================================
+{
+	reflectBorders(heights[current]);
+
+	float c = std::min(std::max(stiffness, 0.0f), 0.5f);
+	float d = damping;
+	bool simd = vectorized;
+
+	if (width * height < MIN_CELLS_FOR_THREADS)
+		stepRows(0, height, c, d, simd);
+	else
+		ThreadPool::shared().parallelFor(height,
+			[this, c, d, simd](int begin, int end) { stepRows(begin, end, c, d, simd); },
+			threadCount);
+
+	current ^= 1;
+}
+
+//************************************************************************
+//
+// * Splat a cosine bump into the height grid
+//========================================================================
+void WaveSolver::
+addDrop(float u, float v, float radius, float strength)
+//========================================================================
+{
+	float cx = u * (width - 1);
+	float cy = v * (height - 1);
+	float r = radius * std::max(width, height);
+	if (r < 1.0f)
+		r = 1.0f;
+
+	int x0 = std::max(0, (int)floor(cx - r));
+	int x1 = std::min(width - 1, (int)ceil(cx + r));
+	int y0 = std::max(0, (int)floor(cy - r));
+	int y1 = std::min(height - 1, (int)ceil(cy + r));
+
+	std::vector<float>& h = heights[current];
+	for (int y = y0; y <= y1; ++y) {
+		for (int x = x0; x <= x1; ++x) {
+			float dx = x - cx;
+			float dy = y - cy;
+			float dist = sqrt(dx * dx + dy * dy);
+			if (dist < r)
+				h[index(x, y)] += strength * 0.5f * (cos(3.14159265f * dist / r) + 1.0f);
+		}
+	}
+}
+
+//************************************************************************
+//
+// *
+//========================================================================
+float WaveSolver::
+heightAt(int x, int y) const
+//========================================================================
+{
+	return heights[current][index(x, y)];
+}
+
+//************************************************************************
+//
+// * Copy the interior out without the ghost ring and row padding
+//========================================================================
+void WaveSolver::
+copyHeights(float* out) const
+//========================================================================
+{
+	const std::vector<float>& h = heights[current];
+	for (int y = 0; y < height; ++y)
+		std::copy(h.begin() + index(0, y), h.begin() + index(0, y) + width, out + (size_t)y * width);
+}
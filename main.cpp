@@ -24,6 +24,9 @@
 
 #include "stdio.h"
 #include "TrainWindow.H"
+#include "TrainView.H"
+#include "Benchmark.H"
+#include "Utilities/TraceRecorder.H"
 
 #pragma warning(push)
 #pragma warning(disable:4312)
@@ -32,12 +35,45 @@
 #pragma warning(pop)
 
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
 	printf("CS559 Train Assignment\n");
 
+	BenchmarkSettings settings;
+	if (!settings.parse(argc, argv)) {
+		printf("usage: see Benchmark.H for the benchmark options\n");
+		return 2;
+	}
+
+	TraceRecorder::shared().nameThread("main");
+	if (!settings.trace.empty())
+		TraceRecorder::shared().capture(settings.trace, settings.traceStart, settings.traceFrames);
+
 	TrainWindow tw;
+	tw.trainView->waterUpdatePolicy = (WaterFrameBuffers::UpdatePolicy)settings.updatePolicy;
+	tw.trainView->waterUpdateInterval = settings.updateInterval;
+	tw.trainView->waterMoveThreshold = settings.moveThreshold;
+	tw.trainView->waterTurnThreshold = settings.turnThreshold;
+
+	Benchmark benchmark(settings);
+	if (!settings.output.empty()) {
+		if (!benchmark.load(tw.trainView->arcball.getPose()))
+			return 1;
+		tw.startBenchmark(&benchmark);
+	}
+
+	CameraPath recording;
+	if (!settings.recordCamera.empty())
+		tw.trainView->cameraRecording = &recording;
+
 	tw.show();
 
 	Fl::run();
+	TraceRecorder::shared().endCapture();
+
+	if (!settings.recordCamera.empty() && !recording.save(settings.recordCamera.c_str())) {
+		printf("ERROR::CAMERA_PATH::CANNOT_WRITE %s\n", settings.recordCamera.c_str());
+		return 1;
+	}
+	return tw.benchmarkPassed ? 0 : 1;
 }
\ No newline at end of file
@@ -14,16 +14,8 @@ vec3 binormal = vec3(0.0f, 0.0f, 1.0f);
 uniform mat4 u_model;
 uniform float amplitude;
 uniform float wavelength;
-uniform float time;
 
-uniform vec3 cameraPosition;
-uniform vec3 lightPosition;
-
-layout (std140, binding = 0) uniform commom_matrices
-{
-    mat4 u_projection;
-    mat4 u_view;
-};
+#include "include/frame_constants.glsl"
 
 out V_OUT
 {
@@ -42,7 +34,7 @@ vec3 GerstnerWave(vec4 wave, vec3 p)
     float k = 2 * PI / wavelength;
     float c = sqrt(9.8 / k);
     vec2 d = normalize(wave.xy);
-    float f = k * (dot(d, p.xz) - c * time);
+    float f = k * (dot(d, p.xz) - c * u_time);
     float a = steepness / k;
     
     tangent += vec3(-d.x * d.x * (steepness * sin(f)), d.x * (steepness * cos(f)), -d.x * d.y * (steepness * sin(f)));
@@ -3,30 +3,39 @@ layout (location = 0) in vec3 position;
 layout (location = 1) in vec3 normal;
 layout (location = 2) in vec2 texture_coordinate;
 
-const float PI = 3.14159;
-const float speed = 1.0f;
-
-vec2 dropPoint = vec2(-1.0f, -1.0f);
-float interactiveAmplitude = 0.15f;
-float interactiveWavelength = 0.5f;
-float interactiveSpeed = 8.0f;
+#include "include/features.glsl"
 
 uniform mat4 u_model;
-uniform sampler2D u_texture;
 
+// WAVE_HEIGHTMAP: every heightmap frame is one layer; u_layer may be
+// fractional to blend between neighbouring frames. WAVE_RIPPLES and
+// WAVE_OCEAN: one layer of heights centred on the water level
+uniform sampler2DArray u_texture;
+#if WAVE_MODEL == WAVE_HEIGHTMAP
+uniform float u_layer;
+uniform int u_layerCount;
+
+// height of the flat water in the 8-bit frames
+const float heightBias = 0.5f;
+#else
+const float heightBias = 0.0f;
+#endif
 uniform float amplitude;
 uniform float wavelength;
-uniform float time;
 
-uniform float interactiveRadius;
+#if NORMAL_MAP
+// dh/du and dh/dv of the heights per unit of texture coordinate
+uniform sampler2DArray u_slopes;
 
-uniform float dropTime;
+// side of the water grid in model units, GridMesh's default
+const float gridSize = 2.0f;
+#endif
 
-layout (std140, binding = 0) uniform commom_matrices
-{
-    mat4 u_projection;
-    mat4 u_view;
-};
+#include "include/frame_constants.glsl"
+
+#if DROPS
+#include "include/drops.glsl"
+#endif
 
 out V_OUT
 {
@@ -39,25 +48,38 @@ out V_OUT
 void main()
 {
     vec3 heightMap = position;
-    float tempHeight = (texture(u_texture, texture_coordinate / 200).r - 0.5f) * amplitude;
-    float tempInteractive = 0.0f;
-    if(dropPoint.x > 0.0f)
-    {        
-        float d = distance(texture_coordinate, dropPoint) / interactiveWavelength * 100.0f;
-        float t = (time - dropTime) * (interactiveRadius * PI) * interactiveSpeed;
-        tempInteractive = interactiveAmplitude * sin((d - t) * clamp(0.0125f * t, 0.0f, 1.0f)) / (exp(0.1f * abs(d - t) + (0.05f * t))) * 1.5f;
-    }
+#if WAVE_MODEL == WAVE_HEIGHTMAP
+    float layer0 = floor(u_layer);
+    float layer1 = mod(layer0 + 1.0f, float(u_layerCount));
+    float frame = mix(texture(u_texture, vec3(texture_coordinate, layer0)).r,
+                      texture(u_texture, vec3(texture_coordinate, layer1)).r,
+                      u_layer - layer0);
+#else
+    float frame = texture(u_texture, vec3(texture_coordinate, 0.0f)).r;
+#endif
+    float tempHeight = (frame - heightBias) * amplitude;
+#if DROPS
+    float tempInteractive = dropRipples(texture_coordinate);
     
     if((tempHeight < 0 && tempInteractive > 0)||(tempHeight > 0 && tempInteractive < 0))
         heightMap.y += (tempHeight + tempInteractive);
     else
         heightMap.y += (abs(tempHeight) > abs(tempInteractive)) ? tempHeight : tempInteractive;
+#else
+    heightMap.y += tempHeight;
+#endif
     
     vec4 worldPosition = u_model * vec4(position, 1.0f);
     v_out.clipSpace = u_projection * u_view * worldPosition;
     gl_Position = u_projection * u_view * u_model * vec4(heightMap, 1.0f);
     
     v_out.position = vec3(u_model * vec4(heightMap, 1.0f));
-    v_out.normal = mat3(transpose(inverse(u_model))) * normal;
+#if NORMAL_MAP
+    vec2 slope = texture(u_slopes, vec3(texture_coordinate, 0.0f)).rg * amplitude / gridSize;
+    vec3 surfaceNormal = normalize(vec3(-slope.x, 1.0f, -slope.y));
+#else
+    vec3 surfaceNormal = normal;
+#endif
+    v_out.normal = mat3(transpose(inverse(u_model))) * surfaceNormal;
     v_out.texture_coordinate = vec2(texture_coordinate.x, 1.0f - texture_coordinate.y);
 }
\ No newline at end of file
@@ -0,0 +1,41 @@
+// the live drops, DropBlock in RenderUtilities/DropBlock.h
+
+const float PI = 3.14159;
+
+// must match MAX_DROP_AMOUNT in RenderUtilities/DropBlock.h
+const int MAX_DROPS = 64;
+
+const float interactiveAmplitude = 0.15f;
+const float interactiveWavelength = 0.5f;
+const float interactiveSpeed = 8.0f;
+
+struct Drop
+{
+    vec2 point;
+    float time;
+    float radius;
+    float keepTime;
+};
+
+layout (std140, binding = 1) uniform drops
+{
+    int u_dropAmount;
+    Drop u_drops[MAX_DROPS];
+};
+
+// height of every live ripple at uv
+float dropRipples(vec2 uv)
+{
+    float height = 0.0f;
+    for(int i = 0; i < u_dropAmount; ++i)
+    {
+        float age = u_time - u_drops[i].time;
+        if(age > u_drops[i].keepTime)
+            continue;
+
+        float d = distance(uv, u_drops[i].point) / interactiveWavelength * 100.0f;
+        float t = age * (u_drops[i].radius * PI) * interactiveSpeed;
+        height += interactiveAmplitude * sin((d - t) * clamp(0.0125f * t, 0.0f, 1.0f)) / (exp(0.1f * abs(d - t) + (0.05f * t))) * 1.5f;
+    }
+    return height;
+}
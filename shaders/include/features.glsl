@@ -0,0 +1,31 @@
+// feature flags of the water programs; ShaderVariants #defines them for
+// each variant, see WaterFeatures in RenderUtilities/ShaderVariants.h
+// for what they mean. Without a define the default below is used.
+
+#define WAVE_SINE 1
+#define WAVE_HEIGHTMAP 2
+#define WAVE_RIPPLES 3
+#define WAVE_OCEAN 4
+
+#define REFLECTION_SKYBOX 0
+#define REFLECTION_PLANAR 1
+
+#define QUALITY_LOW 0
+#define QUALITY_MEDIUM 1
+#define QUALITY_HIGH 2
+
+#ifndef WAVE_MODEL
+#define WAVE_MODEL WAVE_HEIGHTMAP
+#endif
+#ifndef DROPS
+#define DROPS 1
+#endif
+#ifndef REFLECTION
+#define REFLECTION REFLECTION_SKYBOX
+#endif
+#ifndef QUALITY
+#define QUALITY QUALITY_HIGH
+#endif
+#ifndef NORMAL_MAP
+#define NORMAL_MAP 0
+#endif
@@ -0,0 +1,10 @@
+// per-pass constants, FrameConstants in RenderUtilities/FrameConstants.h
+layout (std140, binding = 0) uniform commom_matrices
+{
+    mat4 u_projection;
+    mat4 u_view;
+    vec4 u_cameraPosition;
+    vec4 u_lightPosition;
+    vec4 u_lightColor;
+    float u_time;
+};
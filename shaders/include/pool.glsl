@@ -0,0 +1,92 @@
+#include "features.glsl"
+
+// the tiled pool around the water and the sky above it
+//
+// QUALITY_HIGH follows a refracted ray to the wall or floor it hits,
+// QUALITY_MEDIUM only to the floor, QUALITY_LOW not at all
+
+const float Eta = 0.95f;
+const float ratio_of_reflection_and_refraction = 0.5f;
+const vec3 waterTint = vec3(0.0f, 0.8f, 1.0f);
+
+uniform samplerCube skybox;
+uniform sampler2D tiles;
+
+vec2 intersectCube(vec3 origin, vec3 ray, vec3 cubeMin, vec3 cubeMax) 
+{
+	vec3 tMin = (cubeMin - origin) / ray;
+	vec3 tMax = (cubeMax - origin) / ray;
+	vec3 t1 = min(tMin, tMax);
+	vec3 t2 = max(tMin, tMax);
+	float tNear = max(max(t1.x, t1.y), t1.z);
+	float tFar = min(min(t2.x, t2.y), t2.z);
+	return vec2(tNear, tFar);
+}
+
+vec3 getWallColor(vec3 point) 
+{
+	float scale = 0.5f;
+
+	vec3 wallColor;
+	vec3 normal;
+
+	if (abs(point.x) > 0.999f) 
+    {
+		wallColor = texture(tiles, point.yz * 0.5f + vec2(1.0f, 0.5f)).rgb;
+		normal = vec3(-point.x, 0.0f, 0.0f);
+	} 
+    else if (abs(point.z) > 0.999f) 
+    {
+		wallColor = texture(tiles, point.yx * 0.5f + vec2(1.0f, 0.5f)).rgb;
+		normal = vec3(0.0f, 0.0f, -point.z);
+	} 
+    else 
+    {
+		wallColor = texture(tiles, point.xz * 0.5f + 0.5f).rgb;
+		normal = vec3(0.0f, 1.0f, 0.0f);
+	}
+
+	scale /= length(point);
+	
+
+	return wallColor * scale;
+}
+
+vec3 getSurfaceRayColor(vec3 origin, vec3 ray, vec3 waterColor) 
+{
+    vec3 color;
+#if QUALITY == QUALITY_LOW
+    color = vec3(0.5f);
+#else
+    if (ray.y < 0.0) 
+    {
+#if QUALITY == QUALITY_HIGH
+        vec2 temp = intersectCube(origin, ray, vec3(-1.0f, -1.0f, -1.0f), vec3(1.0f, 1.0f, 1.0f));
+        color = getWallColor(origin + ray * temp.y);
+#else
+        // straight down to the floor at y = -1
+        color = getWallColor(origin + ray * ((-1.0f - origin.y) / ray.y));
+#endif
+    }
+    else
+        color = vec3(texture(skybox, ray));
+#endif
+    
+    color *= waterColor;
+    return color;
+}
+
+#if REFLECTION == REFLECTION_PLANAR
+// the scene mirrored in the water, rendered by the reflection pass
+uniform sampler2D reflectionTexture;
+#endif
+
+// what the water mirrors, ndc is where the fragment is on the screen
+vec3 getReflectionColor(vec3 reflectionVector, vec2 ndc)
+{
+#if REFLECTION == REFLECTION_PLANAR
+    return texture(reflectionTexture, ndc).rgb;
+#else
+    return vec3(texture(skybox, reflectionVector));
+#endif
+}
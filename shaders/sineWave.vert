@@ -16,11 +16,7 @@ uniform float time;
 uniform vec3 cameraPosition;
 uniform vec3 lightPosition;
 
-layout (std140, binding = 0) uniform commom_matrices
-{
-    mat4 u_projection;
-    mat4 u_view;
-};
+#include "include/frame_constants.glsl"
 
 out V_OUT
 {
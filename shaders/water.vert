@@ -5,11 +5,7 @@ layout (location = 2) in vec2 texture_coordinate;
 
 uniform mat4 u_model;
 
-layout (std140, binding = 0) uniform commom_matrices
-{
-    mat4 u_projection;
-    mat4 u_view;
-};
+#include "include/frame_constants.glsl"
 
 out V_OUT
 {
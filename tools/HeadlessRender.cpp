@@ -0,0 +1,628 @@
+/************************************************************************
+     File:        HeadlessRender.cpp
+
+     Comment:
+						Renders the water scene without a window, for batch
+						and CI runs on machines without a GPU or a display.
+
+						The context is a surfaceless EGL one (Mesa's
+						llvmpipe works), or OSMesa when built with
+						HEADLESS_OSMESA. Everything is drawn into an FBO
+						and read back after every frame.
+
+						HeadlessRender [options]
+							--size WxH			target size, 640x480
+							--frames N			frames to render, 60
+							--mode M			wave mode as in the wave
+												browser: 1 sine, 2 heightmap,
+												3 ripples, 4 FFT ocean
+							--eye x,y,z			camera position
+							--target x,y,z		point the camera looks at
+							--fov degrees		vertical field of view, 40
+							--quality Q			water shader tier: 0 low,
+												1 medium, 2 high
+							--gpu-waves			mode 3 on the compute shader
+												solver, checked against the
+												CPU solver every frame
+							--tolerance e		largest height difference
+												allowed by that check, 1e-4
+							--drops file		drop script, one drop per
+												line: frame u v radius keep
+							--out dir			write checksums.txt there
+							--ppm				also write frame_NNNN.ppm
+
+						Each frame is one fixed 1/30 s simulation step, so
+						a run is deterministic for a given driver. A 64 bit
+						FNV-1a checksum of every frame's pixels is printed
+						(and written to checksums.txt), followed by the
+						mean time per frame.
+
+						With --gpu-waves the CPU solver still runs next to
+						the GPU one; the largest height difference of each
+						frame is printed, and the run fails once it is over
+						the tolerance.
+
+						tools/CMakeLists.txt builds it with the other tools
+						and runs it as a test, from the project directory
+						like the window.
+
+						The scene is the sky box and the water surface,
+						drawn by the same code as the window
+						(RenderUtilities/WaterScene.h) with the same
+						shaders, meshes, constants and wave code; the
+						fixed-function train, track and pool tiles are left
+						out.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+#if defined(HEADLESS_OSMESA)
+	#include <GL/osmesa.h>
+#else
+	#include <EGL/egl.h>
+	#include <EGL/eglext.h>
+#endif
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../RenderUtilities/BufferObject.h"
+#include "../RenderUtilities/Camera.h"
+#include "../RenderUtilities/DropBlock.h"
+#include "../RenderUtilities/FrameConstants.h"
+#include "../RenderUtilities/GpuWaveSolver.h"
+#include "../RenderUtilities/GridMesh.h"
+#include "../RenderUtilities/HeightMapSequence.h"
+#include "../RenderUtilities/Shader.h"
+#include "../RenderUtilities/ShaderVariants.h"
+#include "../RenderUtilities/Texture.h"
+#include "../RenderUtilities/TextureArray.h"
+#include "../RenderUtilities/WaterScene.h"
+#include "../TessendorfOcean.H"
+#include "../Utilities/SimulationClock.H"
+#include "../WaveSolver.H"
+
+#ifndef PROJECT_DIR
+	#define PROJECT_DIR "."
+#endif
+
+struct Options
+{
+	int width = 640;
+	int height = 480;
+	int frames = 60;
+	int mode = 1;
+	glm::vec3 eye = glm::vec3(0.0f, 150.0f, 250.0f);
+	glm::vec3 target = glm::vec3(0.0f, 60.0f, 0.0f);
+	float fieldOfView = 40.0f;
+	int quality = WaterFeatures::QUALITY_HIGH;
+	float amplitude = 0.1f;
+	float wavelength = 0.5f;
+	std::string dropScript;
+	std::string outDir;
+	bool images = false;
+	bool gpuWaves = false;
+	float tolerance = 1e-4f;
+};
+
+struct ScriptedDrop
+{
+	int frame;
+	float u, v;
+	float radius;
+	float keepTime;
+};
+
+//************************************************************************
+//
+// * Parse "x,y,z"
+//========================================================================
+static bool parseVec3(const char* text, glm::vec3& out)
+//========================================================================
+{
+	return sscanf(text, "%f,%f,%f", &out.x, &out.y, &out.z) == 3;
+}
+
+//************************************************************************
+//
+// * Read the command line, false on anything it does not know
+//========================================================================
+static bool parseOptions(int argc, char** argv, Options& options)
+//========================================================================
+{
+	for (int i = 1; i < argc; ++i) {
+		const char* arg = argv[i];
+		const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+
+		if (!strcmp(arg, "--ppm")) {
+			options.images = true;
+			continue;
+		}
+		if (!strcmp(arg, "--gpu-waves")) {
+			options.gpuWaves = true;
+			continue;
+		}
+		if (!value)
+			return false;
+		++i;
+
+		if (!strcmp(arg, "--size")) {
+			if (sscanf(value, "%dx%d", &options.width, &options.height) != 2)
+				return false;
+		}
+		else if (!strcmp(arg, "--frames"))
+			options.frames = atoi(value);
+		else if (!strcmp(arg, "--mode"))
+			options.mode = atoi(value);
+		else if (!strcmp(arg, "--eye")) {
+			if (!parseVec3(value, options.eye))
+				return false;
+		}
+		else if (!strcmp(arg, "--target")) {
+			if (!parseVec3(value, options.target))
+				return false;
+		}
+		else if (!strcmp(arg, "--fov"))
+			options.fieldOfView = (float)atof(value);
+		else if (!strcmp(arg, "--quality"))
+			options.quality = atoi(value);
+		else if (!strcmp(arg, "--tolerance"))
+			options.tolerance = (float)atof(value);
+		else if (!strcmp(arg, "--drops"))
+			options.dropScript = value;
+		else if (!strcmp(arg, "--out"))
+			options.outDir = value;
+		else
+			return false;
+	}
+	return options.width > 0 && options.height > 0 && options.frames > 0
+		&& options.mode >= 1 && options.mode <= 4
+		&& options.quality >= 0 && options.quality < WaterFeatures::QUALITY_COUNT;
+}
+
+//************************************************************************
+//
+// * Read the drop script, blank lines and # comments are skipped
+//========================================================================
+static bool readDropScript(const std::string& path, std::vector<ScriptedDrop>& drops)
+//========================================================================
+{
+	std::ifstream file(path.c_str());
+	if (!file)
+		return false;
+
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#')
+			continue;
+		std::istringstream fields(line);
+		ScriptedDrop drop;
+		if (fields >> drop.frame >> drop.u >> drop.v >> drop.radius >> drop.keepTime)
+			drops.push_back(drop);
+		else
+			std::cout << "ERROR::HEADLESS::BAD_DROP_LINE " << line << std::endl;
+	}
+	return true;
+}
+
+//************************************************************************
+//
+// * Make a GL 4.3 core context current without any window
+//========================================================================
+static bool createContext(int width, int height)
+//========================================================================
+{
+#if defined(HEADLESS_OSMESA)
+	const int attributes[] = {
+		OSMESA_FORMAT, OSMESA_RGBA,
+		OSMESA_DEPTH_BITS, 24,
+		OSMESA_PROFILE, OSMESA_CORE_PROFILE,
+		OSMESA_CONTEXT_MAJOR_VERSION, 4,
+		OSMESA_CONTEXT_MINOR_VERSION, 3,
+		0
+	};
+	OSMesaContext context = OSMesaCreateContextAttribs(attributes, nullptr);
+	if (!context)
+		return false;
+
+	// OSMesa needs a buffer to make the context current, the frames
+	// themselves go to an FBO
+	static std::vector<unsigned char> buffer;
+	buffer.resize((size_t)width * height * 4);
+	if (!OSMesaMakeCurrent(context, &buffer[0], GL_UNSIGNED_BYTE, width, height))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)OSMesaGetProcAddress) != 0;
+#else
+	EGLDisplay display = EGL_NO_DISPLAY;
+	PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (getPlatformDisplay)
+		display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	if (display == EGL_NO_DISPLAY)
+		display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+	if (!eglBindAPI(EGL_OPENGL_API))
+		return false;
+
+	const EGLint configAttributes[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	// the surfaceless platform has no configs at all, the context is then
+	// made without one (EGL_KHR_no_config_context)
+	EGLConfig config = EGL_NO_CONFIG_KHR;
+	EGLint configCount = 0;
+	if (!eglChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+		config = EGL_NO_CONFIG_KHR;
+
+	const EGLint contextAttributes[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+	if (context == EGL_NO_CONTEXT)
+		return false;
+
+	// needs EGL_KHR_surfaceless_context, the frames go to an FBO
+	if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+#endif
+}
+
+//************************************************************************
+//
+// * Cube map from the six sky box faces
+//========================================================================
+static GLuint loadCubemap()
+//========================================================================
+{
+	const char* faces[] = {
+		"Images/skybox/right.jpg", "Images/skybox/left.jpg",
+		"Images/skybox/top.jpg", "Images/skybox/bottom.jpg",
+		"Images/skybox/front.jpg", "Images/skybox/back.jpg",
+	};
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_CUBE_MAP, texture);
+	for (GLenum i = 0; i < 6; ++i) {
+		cv::Mat img = cv::imread(faces[i], cv::IMREAD_COLOR);
+		if (img.empty())
+			std::cout << "ERROR::HEADLESS::MISSING_IMAGE " << faces[i] << std::endl;
+		else
+			glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, img.cols, img.rows, 0, GL_BGR, GL_UNSIGNED_BYTE, img.data);
+	}
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+	return texture;
+}
+
+//************************************************************************
+//
+// * Heightmap frames, baked if there is a sequence, the PNGs otherwise
+//========================================================================
+static Texture2DArray* loadHeightMaps()
+//========================================================================
+{
+	HeightMapSequence sequence;
+	if (sequence.open("Images/waves5.hmsq")) {
+		const HeightMapSequenceHeader& header = sequence.header;
+		Texture2DArray* texture = new Texture2DArray(header.width, header.height, header.frameCount,
+													 header.bytesPerPixel == 2 ? GL_R16 : GL_R8);
+		for (unsigned int i = 0; i < header.frameCount; ++i)
+			texture->upload(i, sequence.frame(i));
+		return texture;
+	}
+
+	std::vector<std::string> frames;
+	char name[64];
+	for (int i = 0; i < 200; ++i) {
+		snprintf(name, sizeof(name), "Images/waves5/%03d.png", i);
+		frames.push_back(name);
+	}
+	return new Texture2DArray(frames);
+}
+
+//************************************************************************
+//
+// * 64 bit FNV-1a
+//========================================================================
+static unsigned long long checksum(const std::vector<unsigned char>& bytes)
+//========================================================================
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (size_t i = 0; i < bytes.size(); ++i) {
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+//************************************************************************
+//
+// * Write RGBA pixels read from GL (bottom row first) as a binary PPM
+//========================================================================
+static bool writePPM(const std::string& path, const std::vector<unsigned char>& pixels,
+					 int width, int height)
+//========================================================================
+{
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+		return false;
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	std::vector<unsigned char> row((size_t)width * 3);
+	for (int y = height - 1; y >= 0; --y) {
+		const unsigned char* source = &pixels[(size_t)y * width * 4];
+		for (int x = 0; x < width; ++x) {
+			row[x * 3 + 0] = source[x * 4 + 0];
+			row[x * 3 + 1] = source[x * 4 + 1];
+			row[x * 3 + 2] = source[x * 4 + 2];
+		}
+		fwrite(&row[0], 1, row.size(), file);
+	}
+	fclose(file);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		std::cout << "usage: HeadlessRender [--size WxH] [--frames N] [--mode 1-4]"
+			" [--eye x,y,z] [--target x,y,z] [--fov degrees] [--quality 0-2]"
+			" [--gpu-waves] [--tolerance e] [--drops file] [--out dir] [--ppm]" << std::endl;
+		return 2;
+	}
+
+	std::vector<ScriptedDrop> script;
+	if (!options.dropScript.empty() && !readDropScript(options.dropScript, script)) {
+		std::cout << "ERROR::HEADLESS::CANNOT_READ " << options.dropScript << std::endl;
+		return 1;
+	}
+
+	if (!createContext(options.width, options.height)) {
+		std::cout << "ERROR::HEADLESS::NO_CONTEXT" << std::endl;
+		return 1;
+	}
+	std::cout << "HEADLESS_RENDER " << glGetString(GL_RENDERER) << " "
+		<< glGetString(GL_VERSION) << std::endl;
+
+	// color and depth target
+	GLuint frameBuffer, colorBuffer, depthBuffer;
+	glGenFramebuffers(1, &frameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+	glGenRenderbuffers(1, &colorBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, options.width, options.height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+	glGenRenderbuffers(1, &depthBuffer);
+	glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, options.width, options.height);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+		std::cout << "ERROR::HEADLESS::FRAMEBUFFER_INCOMPLETE" << std::endl;
+		return 1;
+	}
+
+	// the same shaders and meshes as the window
+	Shader skyboxShader(PROJECT_DIR "/src/shaders/skybox.vert", nullptr, nullptr, nullptr,
+						PROJECT_DIR "/src/shaders/skybox.frag");
+	ShaderVariants waterVariants(PROJECT_DIR "/src/shaders", nullptr);
+	GLuint skyboxVAO = createSkyboxVAO();
+	// one fixed step of the window's clock per frame
+	const float stepSeconds = (float)SimulationClock().stepSeconds();
+	GLuint cubemapTexture = loadCubemap();
+	Texture2D tilesTexture(PROJECT_DIR "/Images/tiles.jpg");
+	GridMesh grid(WATER_GRID_RESOLUTION);
+	VAO* waterGrid = grid.createVAO();
+
+	// only the wave source of the chosen mode
+	Texture2DArray* heightTexture = nullptr;
+	WaveSolver* solver = nullptr;
+	GpuWaveSolver* gpuSolver = nullptr;
+	std::vector<float> gpuHeights;
+	TessendorfOcean* ocean = nullptr;
+	std::vector<float> heights;
+	if (options.mode == 2)
+		heightTexture = loadHeightMaps();
+	else if (options.mode == 3) {
+		solver = new WaveSolver(WATER_GRID_RESOLUTION + 1, WATER_GRID_RESOLUTION + 1);
+		heights.resize(solver->getWidth() * solver->getHeight());
+		heightTexture = new Texture2DArray(solver->getWidth(), solver->getHeight(), 1, GL_R32F);
+		heightTexture->setWrap(GL_CLAMP_TO_EDGE);
+		if (options.gpuWaves) {
+			if (!GpuWaveSolver::supported()) {
+				std::cout << "ERROR::HEADLESS::NO_COMPUTE_SHADERS" << std::endl;
+				return 1;
+			}
+			gpuSolver = new GpuWaveSolver(solver->getWidth(), solver->getHeight(), PROJECT_DIR "/src/shaders", nullptr);
+			gpuHeights.resize(heights.size());
+		}
+	}
+	else if (options.mode == 4) {
+		ocean = new TessendorfOcean(256);
+		heights.resize(ocean->getSize() * ocean->getSize());
+		heightTexture = new Texture2DArray(ocean->getSize(), ocean->getSize(), 1, GL_R32F);
+		ocean->update(0.0f, TessendorfOcean::HEIGHTS);
+	}
+
+	FrameConstants frameConstants(1);
+	UBO dropBuffer;
+	dropBuffer.size = sizeof(DropBlock);
+	glGenBuffers(1, &dropBuffer.ubo);
+	glBindBuffer(GL_UNIFORM_BUFFER, dropBuffer.ubo);
+	glBufferData(GL_UNIFORM_BUFFER, dropBuffer.size, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	Camera camera;
+	camera.set(glm::lookAt(options.eye, options.target, glm::vec3(0.0f, 1.0f, 0.0f)),
+			   glm::perspective(glm::radians(options.fieldOfView),
+								(float)options.width / (float)options.height, .1f, 1000.0f));
+
+	std::ofstream checksums;
+	if (!options.outDir.empty()) {
+		checksums.open((options.outDir + "/checksums.txt").c_str());
+		if (!checksums)
+			std::cout << "ERROR::HEADLESS::CANNOT_WRITE " << options.outDir << "/checksums.txt" << std::endl;
+	}
+
+	std::vector<Drop> drops;
+	std::vector<unsigned char> pixels((size_t)options.width * options.height * 4);
+	float time = 0.0f, oceanTime = 0.0f;
+	int layer = 0;
+
+	typedef std::chrono::steady_clock Clock;
+	double total = 0.0;
+	float worstDifference = 0.0f;
+	for (int frame = 0; frame < options.frames; ++frame) {
+		Clock::time_point start = Clock::now();
+
+		// the drops the script places on this frame
+		for (size_t i = 0; i < script.size(); ++i) {
+			if (script[i].frame != frame)
+				continue;
+			// as addDropAt: the ripple solvers carry their drops, only
+			// the other modes draw them from the drop block
+			glm::vec2 uv(script[i].u, script[i].v);
+			if (solver)
+				addRippleDrop(*solver, uv, script[i].radius);
+			if (gpuSolver)
+				addRippleDrop(*gpuSolver, uv, script[i].radius);
+			if (!solver && !gpuSolver && drops.size() < MAX_DROP_AMOUNT)
+				drops.push_back(Drop(uv, time, script[i].radius, script[i].keepTime));
+		}
+		expireDrops(drops, time);
+
+		frameConstants.beginFrame();
+		FrameConstantsBlock block;
+		block.view = camera.view;
+		block.projection = camera.projection;
+		block.cameraPosition = glm::vec4(camera.position, 1.0f);
+		block.lightPosition = glm::vec4(50.0f, 200.0f, 50.0f, 1.0f);
+		block.lightColor = glm::vec4(0.5f, 0.5f, 0.1f, 1.0f);
+		block.time = time;
+		frameConstants.push(block, /*binding point*/0);
+
+		uploadDrops(dropBuffer, drops);
+		glBindBufferRange(GL_UNIFORM_BUFFER, /*binding point*/1, dropBuffer.ubo, 0, dropBuffer.size);
+
+		if (gpuSolver) {
+			// drawn from the GPU images; the read back is only for the check
+			gpuSolver->update();
+			solver->copyHeights(&heights[0]);
+			gpuSolver->copyHeights(&gpuHeights[0]);
+			float difference = 0.0f;
+			for (size_t i = 0; i < heights.size(); ++i)
+				difference = std::max(difference, fabsf(heights[i] - gpuHeights[i]));
+			worstDifference = std::max(worstDifference, difference);
+			std::cout << "SOLVER_DIFF " << frame << " " << difference << std::endl;
+		}
+		else if (solver) {
+			solver->copyHeights(&heights[0]);
+			heightTexture->upload(0, &heights[0]);
+		}
+		else if (ocean) {
+			ocean->copyHeights(&heights[0], OCEAN_HEIGHT_SCALE);
+			heightTexture->upload(0, &heights[0]);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, frameBuffer);
+		glViewport(0, 0, options.width, options.height);
+		glClearColor(0, 0, .3f, 0);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+		glEnable(GL_DEPTH_TEST);
+
+		// water, as TrainView::drawSineWave / drawHeightMapWave; there is
+		// no reflection target here, the water mirrors the sky box
+		WaterFeatures features;
+		features.waveModel = options.mode;
+		features.drops = !drops.empty();
+		features.quality = options.quality;
+		features.normalMap = gpuSolver != nullptr;
+		WaterInputs inputs;
+		inputs.amplitude = options.amplitude;
+		inputs.wavelength = options.wavelength;
+		inputs.grid = waterGrid;
+		inputs.cubemap = cubemapTexture;
+		inputs.tiles = &tilesTexture;
+		inputs.heights = heightTexture;
+		inputs.gpuSolver = gpuSolver;
+		inputs.layer = layer;
+		drawWater(*waterVariants.get(features), features, inputs);
+
+		// sky box last, where nothing was drawn
+		drawSkyBox(skyboxShader, skyboxVAO, cubemapTexture);
+
+		glReadBuffer(GL_COLOR_ATTACHMENT0);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, options.width, options.height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+		frameConstants.endFrame();
+		total += std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		char hash[17];
+		snprintf(hash, sizeof(hash), "%016llx", checksum(pixels));
+		std::cout << "FRAME " << frame << " " << hash << std::endl;
+		if (checksums)
+			checksums << frame << " " << hash << "\n";
+		if (options.images && !options.outDir.empty()) {
+			char name[32];
+			snprintf(name, sizeof(name), "/frame_%04d.ppm", frame);
+			if (!writePPM(options.outDir + name, pixels, options.width, options.height))
+				std::cout << "ERROR::HEADLESS::CANNOT_WRITE " << options.outDir << name << std::endl;
+		}
+
+		// one fixed step, as TrainWindow::advanceTrain
+		if (options.mode == 1)
+			time += stepSeconds * WAVE_TIME_RATE;
+		else if (options.mode == 2)
+			layer = (layer + 1) % heightTexture->layers;
+		else if (options.mode == 3) {
+			solver->step();
+			if (gpuSolver)
+				gpuSolver->step();
+		}
+		else {
+			oceanTime += stepSeconds;
+			ocean->update(oceanTime, TessendorfOcean::HEIGHTS);
+		}
+	}
+
+	GLenum error = glGetError();
+	if (error != GL_NO_ERROR)
+		std::cout << "ERROR::HEADLESS::GL_ERROR 0x" << std::hex << error << std::dec << std::endl;
+
+	std::cout << "HEADLESS_RENDER " << options.width << "x" << options.height
+		<< " mode " << options.mode << " frames " << options.frames
+		<< " mean " << total / options.frames << " ms" << std::endl;
+
+	bool matched = true;
+	if (gpuSolver) {
+		matched = worstDifference <= options.tolerance;
+		std::cout << "SOLVER_CHECK largest difference " << worstDifference << ", tolerance "
+			<< options.tolerance << (matched ? " passed" : " FAILED") << std::endl;
+	}
+	return error == GL_NO_ERROR && matched ? 0 : 1;
+}
@@ -0,0 +1,166 @@
+/************************************************************************
+     File:        HeightMapBaker.cpp
+
+     Comment:
+						Offline tool that packs a directory of heightmap
+						frames (000.png, 001.png, ...) into one *.hmsq file
+						the program can memory-map at startup. See
+						RenderUtilities/HeightMapSequence.h for the layout.
+
+						HeightMapBaker <frame dir> <out.hmsq> [--r16] [--lz4]
+
+						--r16 keeps 16 bit frames at full precision instead
+						of scaling them to 8 bit. --lz4 compresses each frame
+						and needs HEIGHTMAP_SEQUENCE_LZ4 at build time.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../RenderUtilities/HeightMapSequence.h"
+
+//************************************************************************
+//
+// * path of frame index inside dir, zero padded to three digits
+//========================================================================
+static std::string framePath(const std::string& dir, int index)
+//========================================================================
+{
+	char name[16];
+	sprintf(name, "%03d.png", index);
+	return dir + "/" + name;
+}
+
+//************************************************************************
+//
+// * red channel of img as tightly packed 8 or 16 bit pixels
+//========================================================================
+static bool packFrame(const cv::Mat& img, uint32_t bytesPerPixel, std::vector<unsigned char>& out)
+//========================================================================
+{
+	cv::Mat red;
+	if (img.channels() == 1)
+		red = img;
+	else
+		// OpenCV stores BGR(A), red is channel 2
+		cv::extractChannel(img, red, 2);
+
+	int depth = bytesPerPixel == 2 ? CV_16U : CV_8U;
+	if (red.depth() != depth) {
+		double scale = 1.0;
+		if (red.depth() == CV_16U && depth == CV_8U)
+			scale = 1.0 / 257.0;
+		else if (red.depth() == CV_8U && depth == CV_16U)
+			scale = 257.0;
+		red.convertTo(red, depth, scale);
+	}
+	if (!red.isContinuous())
+		red = red.clone();
+
+	out.assign(red.data, red.data + red.total() * red.elemSize());
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 3) {
+		std::cout << "usage: HeightMapBaker <frame dir> <out.hmsq> [--r16] [--lz4]" << std::endl;
+		return 1;
+	}
+	std::string dir = argv[1];
+	std::string outPath = argv[2];
+
+	bool r16 = false, lz4 = false;
+	for (int i = 3; i < argc; ++i) {
+		if (!strcmp(argv[i], "--r16"))
+			r16 = true;
+		else if (!strcmp(argv[i], "--lz4"))
+			lz4 = true;
+		else {
+			std::cout << "ERROR::HEIGHTMAP_BAKER::UNKNOWN_OPTION " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+#ifndef HEIGHTMAP_SEQUENCE_LZ4
+	if (lz4) {
+		std::cout << "ERROR::HEIGHTMAP_BAKER::LZ4_NOT_SUPPORTED rebuild with HEIGHTMAP_SEQUENCE_LZ4" << std::endl;
+		return 1;
+	}
+#endif
+
+	HeightMapSequenceHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "HMSQ", 4);
+	header.version = HMSQ_VERSION;
+	header.bytesPerPixel = r16 ? 2 : 1;
+	header.flags = lz4 ? HMSQ_LZ4 : 0;
+
+	// the frames are numbered from 000 until the first one that is missing
+	std::vector<std::vector<unsigned char> > frames;
+	for (int i = 0;; ++i) {
+		cv::Mat img = cv::imread(framePath(dir, i), cv::IMREAD_ANYDEPTH | cv::IMREAD_COLOR);
+		if (img.empty())
+			break;
+
+		if (frames.empty()) {
+			header.width = img.cols;
+			header.height = img.rows;
+		}
+		else if ((uint32_t)img.cols != header.width || (uint32_t)img.rows != header.height) {
+			std::cout << "ERROR::HEIGHTMAP_BAKER::SIZE_MISMATCH " << framePath(dir, i) << std::endl;
+			return 1;
+		}
+
+		std::vector<unsigned char> pixels;
+		packFrame(img, header.bytesPerPixel, pixels);
+#ifdef HEIGHTMAP_SEQUENCE_LZ4
+		if (lz4) {
+			std::vector<unsigned char> packed(LZ4_compressBound((int)pixels.size()));
+			int size = LZ4_compress_default((const char*)&pixels[0], (char*)&packed[0],
+				(int)pixels.size(), (int)packed.size());
+			packed.resize(size);
+			pixels.swap(packed);
+		}
+#endif
+		frames.push_back(pixels);
+	}
+	if (frames.empty()) {
+		std::cout << "ERROR::HEIGHTMAP_BAKER::NO_FRAMES " << framePath(dir, 0) << std::endl;
+		return 1;
+	}
+	header.frameCount = (uint32_t)frames.size();
+
+	std::vector<HeightMapSequenceFrame> table(frames.size());
+	uint64_t offset = sizeof(header) + table.size() * sizeof(HeightMapSequenceFrame);
+	for (size_t i = 0; i < frames.size(); ++i) {
+		table[i].offset = offset;
+		table[i].size = frames[i].size();
+		offset += frames[i].size();
+	}
+
+	std::ofstream out(outPath.c_str(), std::ios::binary);
+	if (!out) {
+		std::cout << "ERROR::HEIGHTMAP_BAKER::CANNOT_WRITE " << outPath << std::endl;
+		return 1;
+	}
+	out.write((const char*)&header, sizeof(header));
+	out.write((const char*)&table[0], table.size() * sizeof(HeightMapSequenceFrame));
+	for (size_t i = 0; i < frames.size(); ++i)
+		out.write((const char*)&frames[i][0], frames[i].size());
+	out.close();
+
+	std::cout << "HEIGHTMAP_BAKER::WROTE " << frames.size() << " frames of "
+		<< header.width << "x" << header.height << " (" << offset << " bytes) to " << outPath << std::endl;
+	return 0;
+}
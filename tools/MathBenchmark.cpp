@@ -0,0 +1,163 @@
+/************************************************************************
+     File:        MathBenchmark.cpp
+
+     Comment:
+						Times the Mat4 operations of Utilities/SimdMath.H
+						against the same work done with glm.
+
+						MathBenchmark [matrices] [rounds]
+
+						Every operation runs over an array of random
+						matrices (or points) so neither side can keep its
+						operands in registers between calls. For each one
+						it prints the ns per item of both libraries and the
+						largest difference between their results.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "../Utilities/SimdMath.H"
+
+typedef std::chrono::steady_clock Clock;
+
+static float randomIn(float low, float high)
+{
+	return low + (high - low) * (rand() / (float)RAND_MAX);
+}
+
+// ns per item of body() run rounds times over count items
+template <class F>
+static double nsPerItem(int rounds, size_t count, const F& body)
+{
+	Clock::time_point start = Clock::now();
+	for (int r = 0; r < rounds; ++r)
+		body();
+	double ns = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+	return ns / ((double)rounds * count);
+}
+
+static float difference(const float* a, const float* b, size_t count)
+{
+	float worst = 0.0f;
+	for (size_t i = 0; i < count; ++i)
+		worst = std::max(worst, fabsf(a[i] - b[i]));
+	return worst;
+}
+
+static void report(const char* name, double simd, double reference, float error)
+{
+	std::cout << std::left << std::setw(18) << name << std::right << std::fixed
+		<< std::setprecision(2) << std::setw(8) << simd << " ns  glm "
+		<< std::setw(8) << reference << " ns  x" << std::setw(5) << reference / simd
+		<< std::scientific << std::setprecision(1) << "  max diff " << error
+		<< std::endl;
+}
+
+int main(int argc, char** argv)
+{
+	size_t count = argc > 1 ? (size_t)atoi(argv[1]) : 1024;
+	int rounds = argc > 2 ? atoi(argv[2]) : 1000;
+
+	// affine matrices with a well conditioned 3x3, so both inverses agree
+	std::vector<Mat4> matrices(count), results(count);
+	std::vector<glm::mat4> glmMatrices(count), glmResults(count);
+	srand(1);
+	for (size_t i = 0; i < count; ++i) {
+		Mat4 m = Mat4::translate(randomIn(-100, 100), randomIn(-100, 100), randomIn(-100, 100))
+			   * Mat4::rotateY(randomIn(0, 6.28f)) * Mat4::rotateX(randomIn(0, 6.28f))
+			   * Mat4::scale(randomIn(0.5f, 2), randomIn(0.5f, 2), randomIn(0.5f, 2));
+		matrices[i] = m;
+		memcpy(&glmMatrices[i][0][0], m.m, sizeof(m.m));
+	}
+
+	std::vector<float> points(count * 4), transformed(count * 4), glmTransformed(count * 4);
+	for (size_t i = 0; i < count * 4; ++i)
+		points[i] = (i % 4 == 3) ? 1.0f : randomIn(-50, 50);
+
+	const float* simd = results[0].m;
+	const float* reference = &glmResults[0][0][0];
+	size_t floats = count * 16;
+	double a, b;
+
+	a = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i + 1 < count; ++i)
+			results[i] = matrices[i] * matrices[i + 1];
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i + 1 < count; ++i)
+			glmResults[i] = glmMatrices[i] * glmMatrices[i + 1];
+	});
+	report("multiply", a, b, difference(simd, reference, floats - 16));
+
+	a = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			results[i] = matrices[i].transposed();
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			glmResults[i] = glm::transpose(glmMatrices[i]);
+	});
+	report("transpose", a, b, difference(simd, reference, floats));
+
+	a = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			matrices[i].inverse(results[i]);
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			glmResults[i] = glm::inverse(glmMatrices[i]);
+	});
+	report("inverse", a, b, difference(simd, reference, floats));
+
+	a = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			results[i] = matrices[i].affineInverse();
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		for (size_t i = 0; i < count; ++i)
+			glmResults[i] = glm::affineInverse(glmMatrices[i]);
+	});
+	report("affine inverse", a, b, difference(simd, reference, floats));
+
+	const Mat4& m = matrices[0];
+	const glm::mat4& glmM = glmMatrices[0];
+
+	a = nsPerItem(rounds, count, [&]() {
+		m.transform(&points[0], &transformed[0], count);
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		const glm::vec4* in = (const glm::vec4*)&points[0];
+		glm::vec4* out = (glm::vec4*)&glmTransformed[0];
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glmM * in[i];
+	});
+	report("transform vec4", a, b, difference(&transformed[0], &glmTransformed[0], count * 4));
+
+	// the same points read as packed xyz
+	a = nsPerItem(rounds, count, [&]() {
+		m.transformPoints(&points[0], &transformed[0], count);
+	});
+	b = nsPerItem(rounds, count, [&]() {
+		const glm::vec3* in = (const glm::vec3*)&points[0];
+		glm::vec3* out = (glm::vec3*)&glmTransformed[0];
+		for (size_t i = 0; i < count; ++i)
+			out[i] = glm::vec3(glmM * glm::vec4(in[i], 1.0f));
+	});
+	report("transform points", a, b, difference(&transformed[0], &glmTransformed[0], count * 3));
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+/************************************************************************
+     File:        OceanBenchmark.cpp
+
+     Comment:
+						Times TessendorfOcean::update() without a window or
+						a GL context.
+
+						OceanBenchmark [size] [frames] [threads] [jonswap]
+
+						Updates every field, then the heights alone, and
+						prints the mean and worst update time of each, the
+						significant wave height of the last frame, which is
+						a quick sanity check of the spectrum scale, and how
+						far the heights alone are from the full update.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "../TessendorfOcean.H"
+
+int main(int argc, char** argv)
+{
+	int size = argc > 1 ? atoi(argv[1]) : 256;
+	int frames = argc > 2 ? atoi(argv[2]) : 100;
+	unsigned int threads = argc > 3 ? (unsigned int)atoi(argv[3]) : 0;
+	bool jonswap = argc > 4 && !strcmp(argv[4], "jonswap");
+
+	// every field, then the heights alone as the app updates it
+	typedef std::chrono::steady_clock Clock;
+	std::vector<float> full;
+	for (int run = 0; run < 2; ++run) {
+		TessendorfOcean::Fields which = run ? TessendorfOcean::HEIGHTS : TessendorfOcean::ALL_FIELDS;
+		TessendorfOcean ocean(size, 250.0f, threads);
+		if (jonswap)
+			ocean.setSpectrum(TessendorfOcean::JONSWAP);
+
+		double total = 0.0, worst = 0.0;
+		for (int i = 0; i < frames; ++i) {
+			Clock::time_point start = Clock::now();
+			ocean.update(i / 30.0f, which);
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			total += ms;
+			if (ms > worst)
+				worst = ms;
+		}
+
+		const std::vector<float>& heights = ocean.getHeights();
+		double sum = 0.0, squares = 0.0;
+		for (size_t i = 0; i < heights.size(); ++i) {
+			sum += heights[i];
+			squares += heights[i] * heights[i];
+		}
+		double mean = sum / heights.size();
+		double significant = 4.0 * sqrt(squares / heights.size() - mean * mean);
+
+		// the heights come out of a transform of their own, not the same
+		// bits as the shared one
+		if (full.empty())
+			full = heights;
+		float error = 0.0f;
+		for (size_t i = 0; i < heights.size(); ++i)
+			error = std::max(error, fabsf(heights[i] - full[i]));
+
+		std::cout << "OCEAN_BENCHMARK " << ocean.getSize() << "x" << ocean.getSize()
+			<< (jonswap ? " jonswap" : " phillips") << (run ? " heights" : " all")
+			<< " frames " << frames
+			<< " mean " << total / frames << " ms worst " << worst << " ms"
+			<< " Hs " << significant << " m error " << error << std::endl;
+	}
+	return 0;
+}
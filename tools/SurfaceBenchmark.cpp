@@ -0,0 +1,137 @@
+/************************************************************************
+     File:        SurfaceBenchmark.cpp
+
+     Comment:
+						Times WaterSurface::query() without a window or a
+						GL context, and checks it against queryReference().
+
+						SurfaceBenchmark [points] [repeats] [threads]
+
+						Every wave model is set up as the window would: the
+						sine wave with its slider defaults, a few seconds
+						of the ripple solver, the ocean, and a made up 8 bit
+						heightmap frame, each but the sine with two live
+						drops. For each model the heights and normals of
+						points spread over the water are queried repeats
+						times, single threaded and on the pool, and once
+						through the reference path. Prints the mean time
+						per batch, the points per second and the largest
+						difference from the reference.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "../TessendorfOcean.H"
+#include "../WaterSurface.H"
+#include "../WaveSolver.H"
+
+typedef std::chrono::steady_clock Clock;
+
+// mean ms per batch of repeats queries
+static double timeQueries(const WaterSurface& surface, const std::vector<float>& x, const std::vector<float>& z,
+						  std::vector<float>& heights, std::vector<float>& normals, int repeats)
+{
+	Clock::time_point start = Clock::now();
+	for (int i = 0; i < repeats; ++i)
+		surface.query(&x[0], &z[0], (int)x.size(), &heights[0], &normals[0]);
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / repeats;
+}
+
+int main(int argc, char** argv)
+{
+	int points = argc > 1 ? atoi(argv[1]) : 100000;
+	int repeats = argc > 2 ? atoi(argv[2]) : 20;
+	unsigned int threads = argc > 3 ? (unsigned int)atoi(argv[3]) : 0;
+	if (points <= 0 || repeats <= 0) {
+		std::cout << "usage: SurfaceBenchmark [points] [repeats] [threads]" << std::endl;
+		return 2;
+	}
+
+	// the window's water: 200 x 200 at the origin, scaled by 100
+	std::vector<float> x(points), z(points);
+	srand(1);
+	for (int i = 0; i < points; ++i) {
+		x[i] = (rand() / (float)RAND_MAX * 2.0f - 1.0f) * 100.0f;
+		z[i] = (rand() / (float)RAND_MAX * 2.0f - 1.0f) * 100.0f;
+	}
+
+	WaveSolver solver(201, 201);
+	solver.addDrop(0.3f, 0.4f, 0.02f, 0.5f);
+	solver.addDrop(0.7f, 0.6f, 0.04f, 0.5f);
+	for (int i = 0; i < 90; ++i)
+		solver.step();
+	std::vector<float> ripples(solver.getWidth() * solver.getHeight());
+	solver.copyHeights(&ripples[0]);
+
+	TessendorfOcean ocean(256);
+	ocean.update(3.0f, TessendorfOcean::HEIGHTS);
+	std::vector<float> oceanHeights(ocean.getSize() * ocean.getSize());
+	ocean.copyHeights(&oceanHeights[0], 0.25f);
+
+	std::vector<unsigned char> frame(256 * 256);
+	for (int j = 0; j < 256; ++j)
+		for (int i = 0; i < 256; ++i)
+			frame[j * 256 + i] = (unsigned char)(127.5f + 120.0f * sinf(i * 0.1f) * cosf(j * 0.07f));
+
+	const WaterSurface::Ripple drops[] = {
+		{ 0.5f, 0.5f, 0.0f, 3.0f, 10.0f },
+		{ 0.2f, 0.8f, 0.5f, 1.0f, 10.0f },
+	};
+
+	std::vector<float> heights(points), normals(3 * points);
+	std::vector<float> referenceHeights(points), referenceNormals(3 * points);
+	bool ok = true;
+	for (int model = WaterSurface::SINE; model <= WaterSurface::OCEAN; ++model) {
+		WaterSurface surface(threads), single(1);
+		WaterSurface* both[] = { &surface, &single };
+		for (int i = 0; i < 2; ++i) {
+			WaterSurface& s = *both[i];
+			s.setPlacement(0.0f, 0.0f, 0.0f, 100.0f);
+			if (model == WaterSurface::SINE)
+				s.setSine(0.1f, 0.5f, 2.0f);
+			else if (model == WaterSurface::HEIGHTMAP)
+				s.setHeightField(WaterSurface::HEIGHTMAP, &frame[0], WaterSurface::UNORM8, 256, 256, true, 0.5f, 0.1f);
+			else if (model == WaterSurface::RIPPLES)
+				s.setHeightField(WaterSurface::RIPPLES, &ripples[0], WaterSurface::FLOAT,
+								 solver.getWidth(), solver.getHeight(), false, 0.0f, 0.1f);
+			else
+				s.setHeightField(WaterSurface::OCEAN, &oceanHeights[0], WaterSurface::FLOAT,
+								 ocean.getSize(), ocean.getSize(), true, 0.0f, 0.1f);
+			if (model != WaterSurface::SINE)
+				s.setRipples(drops, 2, 2.0f);
+		}
+
+		double singleMs = timeQueries(single, x, z, heights, normals, repeats);
+		double poolMs = timeQueries(surface, x, z, heights, normals, repeats);
+
+		Clock::time_point start = Clock::now();
+		surface.queryReference(&x[0], &z[0], points, &referenceHeights[0], &referenceNormals[0]);
+		double referenceMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+		float heightError = 0.0f, normalError = 0.0f;
+		for (int i = 0; i < points; ++i) {
+			heightError = std::max(heightError, fabsf(heights[i] - referenceHeights[i]));
+			for (int k = 0; k < 3; ++k)
+				normalError = std::max(normalError, fabsf(normals[3 * i + k] - referenceNormals[3 * i + k]));
+		}
+		// world heights are around 60, the approximations keep to a few ulps
+		// of the reference, far less than this
+		if (heightError > 1e-3f || normalError > 1e-3f)
+			ok = false;
+
+		std::cout << "SURFACE_BENCHMARK model " << model << " points " << points
+			<< " reference " << referenceMs << " ms, single " << singleMs << " ms, pool " << poolMs << " ms ("
+			<< points / poolMs / 1000.0 << " M points/s) error height " << heightError
+			<< " normal " << normalError << std::endl;
+	}
+	return ok ? 0 : 1;
+}
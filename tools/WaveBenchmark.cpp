@@ -0,0 +1,85 @@
+/************************************************************************
+     File:        WaveBenchmark.cpp
+
+     Comment:
+						Times WaveSolver::step() without a window or a GL
+						context.
+
+						WaveBenchmark [size] [steps] [threads]
+
+						The same grid with the same drops is stepped four
+						ways: the plain C++ kernel and the SIMD one (AVX
+						when built for it, SSE2 otherwise), each single
+						threaded and on the pool with at most threads
+						threads (0 = all of them). Prints the mean and
+						worst step time of each, the cells per second, and
+						the largest difference from the plain single
+						threaded heights.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <stdlib.h>
+#include <math.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "../WaveSolver.H"
+
+int main(int argc, char** argv)
+{
+	int size = argc > 1 ? atoi(argv[1]) : 512;
+	int steps = argc > 2 ? atoi(argv[2]) : 200;
+	unsigned int threads = argc > 3 ? (unsigned int)atoi(argv[3]) : 0;
+
+#if defined(__AVX__)
+	const char* simdName = "avx";
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	const char* simdName = "sse2";
+#else
+	const char* simdName = "none";
+#endif
+
+	typedef std::chrono::steady_clock Clock;
+	std::vector<float> reference;
+	for (int run = 0; run < 4; ++run) {
+		bool vectorized = (run & 1) != 0;
+		bool pooled = run >= 2;
+
+		WaveSolver solver(size, size, pooled ? threads : 1);
+		solver.vectorized = vectorized;
+		for (int i = 0; i < 16; ++i)
+			solver.addDrop((i * 7 % 16) / 16.0f, (i * 11 % 16) / 16.0f, 0.02f, i & 1 ? 1.0f : -1.0f);
+
+		double total = 0.0, worst = 0.0;
+		for (int i = 0; i < steps; ++i) {
+			Clock::time_point start = Clock::now();
+			solver.step();
+			double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+			total += ms;
+			if (ms > worst)
+				worst = ms;
+		}
+
+		std::vector<float> heights(size * size);
+		solver.copyHeights(&heights[0]);
+		if (reference.empty())
+			reference = heights;
+		float error = 0.0f;
+		for (size_t i = 0; i < heights.size(); ++i)
+			error = std::max(error, fabsf(heights[i] - reference[i]));
+
+		double mean = total / steps;
+		std::cout << "WAVE_BENCHMARK " << size << "x" << size
+			<< " " << (vectorized ? simdName : "scalar")
+			<< (pooled ? " pool" : " single") << " steps " << steps
+			<< " mean " << mean << " ms worst " << worst << " ms"
+			<< " (" << size * (double)size / (mean * 1000.0) << " M cells/s)"
+			<< " error " << error << std::endl;
+	}
+	return 0;
+}
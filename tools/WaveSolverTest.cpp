@@ -0,0 +1,272 @@
+/************************************************************************
+     File:        WaveSolverTest.cpp
+
+     Comment:
+						Checks WaveSolver without a window or a GL context.
+
+						WaveSolverTest
+
+						stability	at the largest stiffness, and above it
+									where step() clamps, an undamped drop
+									stays finite and bounded for thousands
+									of steps
+						walls		the borders are mirrors: a drop on the
+									left wall of a grid moves exactly like
+									the right half of a drop in the middle
+									of a grid twice as wide, and no water
+									leaks out
+						drop		the splat peaks at its centre, stays
+									inside its radius and clips at the
+									edges of the grid
+						damping		the wave energy is kept without damping
+									and decays by about damping per step
+									with it
+						kernels		the plain C++ kernel, the SIMD one and
+									the threaded step agree
+
+						Prints one line per check and returns 1 if any of
+						them fails.
+
+     Platform:    Visio Studio.Net 2003/2005
+
+*************************************************************************/
+
+#include <math.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "../WaveSolver.H"
+
+static int failures = 0;
+
+static void check(const char* name, bool ok, const char* what)
+{
+	std::cout << "WAVE_SOLVER_TEST " << name << (ok ? " ok " : " FAIL ") << what << std::endl;
+	if (!ok)
+		++failures;
+}
+
+static std::vector<float> heightsOf(const WaveSolver& solver)
+{
+	std::vector<float> heights(solver.getWidth() * solver.getHeight());
+	solver.copyHeights(&heights[0]);
+	return heights;
+}
+
+static double sumOf(const std::vector<float>& heights)
+{
+	double sum = 0.0;
+	for (size_t i = 0; i < heights.size(); ++i)
+		sum += heights[i];
+	return sum;
+}
+
+static float largestDifference(const std::vector<float>& a, const std::vector<float>& b)
+{
+	float largest = 0.0f;
+	for (size_t i = 0; i < a.size(); ++i)
+		largest = std::max(largest, fabsf(a[i] - b[i]));
+	return largest;
+}
+
+// kinetic plus potential energy of the step from previous to heights: the
+// velocity of a cell is how far it moved, the potential is c times the
+// squared differences between neighbours
+static double energyOf(const std::vector<float>& previous, const std::vector<float>& heights,
+					   int width, int height, float c)
+{
+	double kinetic = 0.0, potential = 0.0;
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			int i = y * width + x;
+			double v = heights[i] - previous[i];
+			kinetic += v * v;
+			if (x + 1 < width)
+				potential += (heights[i + 1] - heights[i]) * (double)(heights[i + 1] - heights[i]);
+			if (y + 1 < height)
+				potential += (heights[i + width] - heights[i]) * (double)(heights[i + width] - heights[i]);
+		}
+	}
+	return kinetic + c * potential;
+}
+
+// mean energy over the next count steps of a solver
+static double meanEnergy(WaveSolver& solver, int count)
+{
+	double total = 0.0;
+	std::vector<float> previous = heightsOf(solver);
+	for (int i = 0; i < count; ++i) {
+		solver.step();
+		std::vector<float> heights = heightsOf(solver);
+		total += energyOf(previous, heights, solver.getWidth(), solver.getHeight(), solver.stiffness);
+		previous.swap(heights);
+	}
+	return total / count;
+}
+
+static void testStability()
+{
+	const float stiffnesses[] = { 0.5f, 4.0f };
+	for (float stiffness : stiffnesses) {
+		WaveSolver solver(96, 96);
+		solver.stiffness = stiffness;
+		solver.damping = 1.0f;
+		solver.addDrop(0.3f, 0.6f, 0.05f, 1.0f);
+		solver.addDrop(0.7f, 0.2f, 0.02f, -1.0f);
+
+		bool finite = true;
+		float largest = 0.0f;
+		for (int i = 0; i < 4000 && finite; ++i) {
+			solver.step();
+			if (i % 100 == 99) {
+				std::vector<float> heights = heightsOf(solver);
+				for (size_t j = 0; j < heights.size(); ++j) {
+					finite = finite && heights[j] == heights[j] && fabsf(heights[j]) < 1e30f;
+					largest = std::max(largest, fabsf(heights[j]));
+				}
+			}
+		}
+		check("stability", finite && largest < 2.0f,
+			  stiffness == 0.5f ? "stiffness 0.5, 4000 undamped steps" : "stiffness 4 clamped, 4000 undamped steps");
+	}
+}
+
+static void testWalls()
+{
+	// the ghost cell of the left wall mirrors column 0, the same as the
+	// cell left of the middle does in a grid twice as wide with a drop
+	// centred between its two middle columns
+	const int width = 32, height = 64;
+	WaveSolver wall(width, height);
+	WaveSolver wide(2 * width, height);
+	wall.damping = wide.damping = 1.0f;
+	// the radius scales with the longer side, height, in both grids
+	wall.addDrop(-0.5f / (width - 1), 0.5f, 0.1f, 1.0f);
+	wide.addDrop(0.5f, 0.5f, 0.1f, 1.0f);
+	double mass = sumOf(heightsOf(wall));
+
+	float largest = 0.0f;
+	for (int i = 0; i < 600; ++i) {
+		wall.step();
+		wide.step();
+		for (int y = 0; y < height; ++y)
+			for (int x = 0; x < width; ++x)
+				largest = std::max(largest, fabsf(wall.heightAt(x, y) - wide.heightAt(width + x, y)));
+	}
+	check("walls", largest < 1e-5f, "a drop on the wall matches its mirror image");
+
+	double after = sumOf(heightsOf(wall));
+	check("walls", fabs(after - mass) < 1e-3 * fabs(mass), "no water leaks through the walls");
+}
+
+static void testDrop()
+{
+	const int size = 65;
+	const float radius = 0.1f;
+	const float r = radius * size;
+
+	WaveSolver solver(size, size);
+	solver.addDrop(0.5f, 0.5f, radius, 0.75f);
+	bool peak = solver.heightAt(32, 32) == 0.75f;
+	bool inside = true, outside = true;
+	for (int y = 0; y < size; ++y) {
+		for (int x = 0; x < size; ++x) {
+			float dist = sqrtf((x - 32.0f) * (x - 32.0f) + (y - 32.0f) * (y - 32.0f));
+			float h = solver.heightAt(x, y);
+			if (dist < r - 0.5f)
+				inside = inside && h > 0.0f && h <= 0.75f;
+			else if (dist >= r)
+				outside = outside && h == 0.0f;
+		}
+	}
+	check("drop", peak, "peaks at the strength in its centre");
+	check("drop", inside && outside, "stays inside its radius");
+
+	// a corner drop keeps to the corner, and one off the grid does nothing
+	solver.reset();
+	solver.addDrop(0.0f, 0.0f, radius, 1.0f);
+	bool corner = solver.heightAt(0, 0) == 1.0f;
+	for (int y = 0; y < size; ++y)
+		for (int x = 0; x < size; ++x)
+			if (x * x + y * y >= r * r)
+				corner = corner && solver.heightAt(x, y) == 0.0f;
+	double mass = sumOf(heightsOf(solver));
+	solver.addDrop(1.5f, -0.5f, radius, 1.0f);
+	corner = corner && sumOf(heightsOf(solver)) == mass;
+	check("drop", corner, "clips at the edges of the grid");
+
+	// a drop smaller than a cell still moves the cell under it
+	solver.reset();
+	solver.addDrop(0.25f, 0.75f, 0.001f, 1.0f);
+	check("drop", solver.heightAt(16, 48) == 1.0f, "a tiny drop still lands");
+}
+
+static void testDamping()
+{
+	const int size = 64;
+	const int window = 50, steps = 1000;
+
+	WaveSolver kept(size, size);
+	kept.damping = 1.0f;
+	kept.addDrop(0.4f, 0.55f, 0.08f, 1.0f);
+	double keptFirst = meanEnergy(kept, window);
+	for (int i = 0; i < steps; ++i)
+		kept.step();
+	double keptLast = meanEnergy(kept, window);
+	check("damping", keptLast > 0.9 * keptFirst && keptLast < 1.1 * keptFirst, "damping 1 keeps the energy");
+
+	const float damping = 0.995f;
+	WaveSolver damped(size, size);
+	damped.damping = damping;
+	damped.addDrop(0.4f, 0.55f, 0.08f, 1.0f);
+	double dampedFirst = meanEnergy(damped, window);
+	double previous = dampedFirst;
+	bool falling = true;
+	for (int i = 0; i < steps / window; ++i) {
+		double energy = meanEnergy(damped, window);
+		falling = falling && energy < previous;
+		previous = energy;
+	}
+	// damping takes damping^2 of the kinetic energy every step, and the
+	// waves keep about half their energy kinetic, so the total falls by
+	// about damping per step
+	double expected = pow(damping, steps + window);
+	double ratio = previous / dampedFirst;
+	check("damping", falling, "the energy falls window after window");
+	check("damping", ratio > 0.5 * expected && ratio < 2.0 * expected, "the energy decays by about damping per step");
+}
+
+static void testKernels()
+{
+	// large enough to be split over the pool, and a width that leaves a
+	// tail after the SIMD lanes
+	const int width = 203, height = 157;
+	WaveSolver scalar(width, height, 1);
+	WaveSolver simd(width, height, 1);
+	WaveSolver pooled(width, height);
+	scalar.vectorized = false;
+	WaveSolver* solvers[] = { &scalar, &simd, &pooled };
+	for (WaveSolver* solver : solvers) {
+		solver->addDrop(0.2f, 0.3f, 0.04f, 1.0f);
+		solver->addDrop(0.8f, 0.6f, 0.02f, -0.5f);
+		for (int i = 0; i < 300; ++i)
+			solver->step();
+	}
+	std::vector<float> reference = heightsOf(scalar);
+	check("kernels", largestDifference(heightsOf(simd), reference) < 1e-6f, "SIMD matches plain C++");
+	check("kernels", largestDifference(heightsOf(pooled), reference) < 1e-6f, "threaded matches single threaded");
+}
+
+int main()
+{
+	testStability();
+	testWalls();
+	testDrop();
+	testDamping();
+	testKernels();
+
+	std::cout << "WAVE_SOLVER_TEST " << (failures ? "FAILED " : "passed ") << failures << " failures" << std::endl;
+	return failures ? 1 : 0;
+}